@@ -7,29 +7,33 @@ extern "C"
 
 #include <string.h>
 
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
 //--------------------------------------
 
-float lerp(float x, float y, float a)
+constexpr float lerp(float x, float y, float a)
 {
     return (1.0f - a) * x + a * y;
 }
 
-float clamp(float x, float minimum, float maximum)
+constexpr float clamp(float x, float minimum, float maximum)
 {
     return x > maximum ? maximum : x < minimum ? minimum : x;
 }
 
-float max(float x, float y)
+constexpr float max(float x, float y)
 {
     return x > y ? x : y;
 }
 
-float min(float x, float y)
+constexpr float min(float x, float y)
 {
     return x < y ? x : y;
 }
 
-float sign(float x)
+constexpr float sign(float x)
 {
     return x > 0.0f ? 1.0f : x < 0.0f ? -1.0f : 0.0f;
 }
@@ -82,7 +86,7 @@ float damper_exact(float x, float g, float halflife, float dt, float eps=1e-5f)
 }
 */
 
-float fast_negexp(float x)
+constexpr float fast_negexp(float x)
 {
     return 1.0f / (1.0f + x + 0.48f*x*x + 0.235f*x*x*x);
 }
@@ -120,7 +124,7 @@ float fast_atan(float x)
     return copysign(z > 1.0f ? M_PI / 2.0 - y : y, x);
 }
 
-float squaref(float x)
+constexpr float squaref(float x)
 {
     return x*x;
 }
@@ -210,17 +214,208 @@ void spring_damper_exact_stiffness_damping(
     }
 }
 
-float halflife_to_damping(float halflife, float eps = 1e-5f)
+//--------------------------------------
+
+enum
+{
+    SPRING_CRITICALLY_DAMPED = 0,
+    SPRING_UNDER_DAMPED = 1,
+    SPRING_OVER_DAMPED = 2,
+};
+
+// Spring parameters with the regime and regime-specific 
+// constants worked out ahead of time, for when the 
+// stiffness and damping of a spring don't change
+struct spring_damper_params
+{
+    int regime;
+    float s;  // Stiffness
+    float d;  // Damping
+    float y;  // Half damping
+    float w;  // Oscillation frequency (under damped only)
+    float y0; // Fast decay rate (over damped only)
+    float y1; // Slow decay rate (over damped only)
+    float cq; // Goal velocity to goal offset scale
+};
+
+void spring_damper_params_stiffness_damping(
+    spring_damper_params& p,
+    float stiffness, 
+    float damping, 
+    float eps = 1e-5f)
+{
+    float s = stiffness;
+    float d = damping;
+    
+    p.s = s;
+    p.d = d;
+    p.y = d / 2.0f;
+    p.w = 0.0f;
+    p.y0 = 0.0f;
+    p.y1 = 0.0f;
+    p.cq = d / (s + eps);
+    
+    if (fabs(s - (d*d) / 4.0f) < eps) // Critically Damped
+    {
+        p.regime = SPRING_CRITICALLY_DAMPED;
+    }
+    else if (s - (d*d) / 4.0f > 0.0) // Under Damped
+    {
+        p.regime = SPRING_UNDER_DAMPED;
+        p.w = sqrtf(s - (d*d)/4.0f);
+    }
+    else // Over Damped
+    {
+        p.regime = SPRING_OVER_DAMPED;
+        p.y0 = (d + sqrtf(d*d - 4*s)) / 2.0f;
+        p.y1 = (d - sqrtf(d*d - 4*s)) / 2.0f;
+    }
+}
+
+void spring_damper_exact_params(
+    float& x, 
+    float& v, 
+    float x_goal, 
+    float v_goal, 
+    const spring_damper_params& p, 
+    float dt, 
+    float eps = 1e-5f)
+{
+    float c = x_goal + p.cq * v_goal;
+    float y = p.y;
+    
+    if (p.regime == SPRING_CRITICALLY_DAMPED)
+    {
+        float j0 = x - c;
+        float j1 = v + j0*y;
+        
+        float eydt = fast_negexp(y*dt);
+        
+        x =  j0*eydt + dt*j1*eydt + c;
+        v = -y*j0*eydt - y*dt*j1*eydt + j1*eydt;
+    }
+    else if (p.regime == SPRING_UNDER_DAMPED)
+    {
+        float w = p.w;
+        float j = sqrtf(squaref(v + y*(x - c)) / (w*w + eps) + squaref(x - c));
+        float ph = fast_atan((v + (x - c) * y) / (-(x - c)*w + eps));
+        
+        j = (x - c) > 0.0f ? j : -j;
+        
+        float eydt = fast_negexp(y*dt);
+        
+        x = j*eydt*cosf(w*dt + ph) + c;
+        v = -y*j*eydt*cosf(w*dt + ph) - w*j*eydt*sinf(w*dt + ph);
+    }
+    else // Over Damped
+    {
+        float y0 = p.y0;
+        float y1 = p.y1;
+        float j1 = (c*y0 - x*y0 - v) / (y1 - y0);
+        float j0 = x - j1 - c;
+        
+        float ey0dt = fast_negexp(y0*dt);
+        float ey1dt = fast_negexp(y1*dt);
+
+        x =  j0*ey0dt + j1*ey1dt + c;
+        v = -y0*j0*ey0dt - y1*j1*ey1dt;
+    }
+}
+
+// For fixed parameters and a fixed dt the exact update is 
+// linear in the offset from the goal and the velocity, so 
+// it can be written as a 2x2 matrix which many springs 
+// can then share without any per-spring branching.
+void spring_damper_transition(
+    float& txx,
+    float& txv,
+    float& tvx,
+    float& tvv,
+    const spring_damper_params& p,
+    float dt)
+{
+    float y = p.y;
+    
+    if (p.regime == SPRING_CRITICALLY_DAMPED)
+    {
+        float eydt = fast_negexp(y*dt);
+        
+        txx = eydt*(1.0f + y*dt);
+        txv = eydt*dt;
+        tvx = -eydt*y*y*dt;
+        tvv = eydt*(1.0f - y*dt);
+    }
+    else if (p.regime == SPRING_UNDER_DAMPED)
+    {
+        float w = p.w;
+        float eydt = fast_negexp(y*dt);
+        float cwdt = cosf(w*dt);
+        float swdt = sinf(w*dt);
+        
+        txx = eydt*(cwdt + (y/w)*swdt);
+        txv = eydt*(swdt/w);
+        tvx = -eydt*(w + (y*y)/w)*swdt;
+        tvv = eydt*(cwdt - (y/w)*swdt);
+    }
+    else // Over Damped
+    {
+        float y0 = p.y0;
+        float y1 = p.y1;
+        float ey0dt = fast_negexp(y0*dt);
+        float ey1dt = fast_negexp(y1*dt);
+        
+        txx = (y1*ey0dt - y0*ey1dt) / (y1 - y0);
+        txv = (ey0dt - ey1dt) / (y1 - y0);
+        tvx = (y0*y1*(ey1dt - ey0dt)) / (y1 - y0);
+        tvv = (y1*ey1dt - y0*ey0dt) / (y1 - y0);
+    }
+}
+
+// Exact update for a goal which is moving during the step. Here 
+// `x_goal` and `v_goal` are the coefficients of cubic polynomials 
+// in the time since the start of the step. The particular solution
+// for a polynomial goal is another cubic polynomial, so we can step
+// the offset from that exactly and add it back on afterwards.
+void spring_damper_exact_params_polynomial_goal(
+    float& x, 
+    float& v, 
+    const float x_goal[4], 
+    const float v_goal[4], 
+    const spring_damper_params& p, 
+    float dt, 
+    float eps = 1e-5f)
+{
+    float s = p.s + eps;
+    float d = p.d;
+    
+    float b3 = x_goal[3] + (d*v_goal[3]) / s;
+    float b2 = x_goal[2] + (d*v_goal[2] - 3.0f*d*b3) / s;
+    float b1 = x_goal[1] + (d*v_goal[1] - 2.0f*d*b2 - 6.0f*b3) / s;
+    float b0 = x_goal[0] + (d*v_goal[0] - d*b1 - 2.0f*b2) / s;
+    
+    float txx, txv, tvx, tvv;
+    spring_damper_transition(txx, txv, tvx, tvv, p, dt);
+    
+    float xc = x - b0;
+    float vc = v - b1;
+    
+    x = txx*xc + txv*vc + b0 + dt*(b1 + dt*(b2 + dt*b3));
+    v = tvx*xc + tvv*vc + b1 + dt*(2.0f*b2 + dt*3.0f*b3);
+}
+
+//--------------------------------------
+
+constexpr float halflife_to_damping(float halflife, float eps = 1e-5f)
 {
     return (4.0f * 0.69314718056f) / (halflife + eps);
 }
     
-float damping_to_halflife(float damping, float eps = 1e-5f)
+constexpr float damping_to_halflife(float damping, float eps = 1e-5f)
 {
     return (4.0f * 0.69314718056f) / (damping + eps);
 }
 
-float frequency_to_stiffness(float frequency)
+constexpr float frequency_to_stiffness(float frequency)
 {
    return squaref(2.0f * M_PI * frequency);
 }
@@ -230,14 +425,17 @@ float stiffness_to_frequency(float stiffness)
     return sqrtf(stiffness) / (2.0f * M_PI);
 }
 
-float critical_halflife(float frequency)
+// The square roots in these cancel with the squares in `frequency_to_stiffness`
+// and `halflife_to_damping`, so are written without them to keep them constexpr
+
+constexpr float critical_halflife(float frequency)
 {
-    return damping_to_halflife(sqrtf(frequency_to_stiffness(frequency) * 4.0f));
+    return damping_to_halflife(4.0f * M_PI * frequency);
 }
 
-float critical_frequency(float halflife)
+constexpr float critical_frequency(float halflife)
 {
-    return stiffness_to_frequency(squaref(halflife_to_damping(halflife)) / 4.0f);
+    return halflife_to_damping(halflife) / (4.0f * M_PI);
 }
 
 void spring_damper_exact(
@@ -295,7 +493,59 @@ void spring_damper_exact(
     }
 }
 
-float damping_ratio_to_stiffness(float ratio, float damping)
+// When the parameters and dt of an under damped spring are fixed, each 
+// step just decays and rotates the offset from the goal (scaled into a
+// complex number), so the cosine, sine and exponential can be computed 
+// once up-front alongside the `spring_damper_params` and each step 
+// needs no transcendentals at all. This also avoids going via the 
+// amplitude and phase which needs the `eps` in the `fast_atan` and 
+// loses accuracy when `x` is close to `c`.
+struct spring_damper_rotation
+{
+    float ec;    // Decay times cosine of rotation
+    float es;    // Decay times sine of rotation
+    float w_inv; // Inverse of oscillation frequency
+};
+
+// Returns false if the spring is not under damped
+bool spring_damper_rotation_init(
+    spring_damper_rotation& rot,
+    const spring_damper_params& p,
+    float dt)
+{
+    if (p.regime != SPRING_UNDER_DAMPED)
+    {
+        return false;
+    }
+    
+    float eydt = fast_negexp(p.y*dt);
+    rot.ec = eydt*cosf(p.w*dt);
+    rot.es = eydt*sinf(p.w*dt);
+    rot.w_inv = 1.0f / p.w;
+    
+    return true;
+}
+
+void spring_damper_exact_rotation(
+    float& x, 
+    float& v, 
+    float x_goal, 
+    float v_goal, 
+    const spring_damper_params& p,
+    const spring_damper_rotation& rot)
+{
+    float c = x_goal + p.cq * v_goal;
+    float a = x - c;
+    float b = (v + p.y*a) * rot.w_inv;
+    
+    float a1 = rot.ec*a + rot.es*b;
+    float b1 = rot.ec*b - rot.es*a;
+    
+    x = a1 + c;
+    v = p.w*b1 - p.y*a1;
+}
+
+constexpr float damping_ratio_to_stiffness(float ratio, float damping)
 {
     return squaref(damping / (ratio * 2.0f));
 }
@@ -416,14 +666,1143 @@ void decay_spring_damper_exact(
 
 //--------------------------------------
 
-float halflife_to_lag(float halflife)
+// Versions of the solvers for springs whose tuning is known at compile 
+// time. `Tuning` should be a type with `static constexpr float` members
+// `halflife` (and `frequency` for `spring_damper_exact_fixed`), e.g.
+//
+//   struct camera_lag { static constexpr float halflife = 0.1f; };
+//
+// All of the conversions are then folded into constants and the regime
+// branch disappears, leaving straight-line code.
+
+constexpr int spring_regime(float stiffness, float damping, float eps = 1e-5f)
+{
+    return 
+        (stiffness - (damping*damping) / 4.0f <  eps &&
+         stiffness - (damping*damping) / 4.0f > -eps) ? SPRING_CRITICALLY_DAMPED :
+         stiffness - (damping*damping) / 4.0f > 0.0f  ? SPRING_UNDER_DAMPED : 
+                                                        SPRING_OVER_DAMPED;
+}
+
+template<typename Tuning>
+void spring_damper_exact_fixed(
+    float& x, 
+    float& v, 
+    float x_goal, 
+    float v_goal, 
+    float dt)
+{
+    constexpr float eps = 1e-5f;
+    constexpr float s = frequency_to_stiffness(Tuning::frequency);
+    constexpr float d = halflife_to_damping(Tuning::halflife);
+    constexpr float y = d / 2.0f;
+    constexpr int regime = spring_regime(s, d);
+    
+    float c = x_goal + (d*v_goal) / (s + eps);
+    
+    if (regime == SPRING_CRITICALLY_DAMPED)
+    {
+        float j0 = x - c;
+        float j1 = v + j0*y;
+        
+        float eydt = fast_negexp(y*dt);
+        
+        x = j0*eydt + dt*j1*eydt + c;
+        v = -y*j0*eydt - y*dt*j1*eydt + j1*eydt;
+    }
+    else if (regime == SPRING_UNDER_DAMPED)
+    {
+        const float w = sqrtf(s - (d*d)/4.0f);
+        float j = sqrtf(squaref(v + y*(x - c)) / (w*w + eps) + squaref(x - c));
+        float p = fast_atan((v + (x - c) * y) / (-(x - c)*w + eps));
+        
+        j = (x - c) > 0.0f ? j : -j;
+        
+        float eydt = fast_negexp(y*dt);
+        
+        x = j*eydt*cosf(w*dt + p) + c;
+        v = -y*j*eydt*cosf(w*dt + p) - w*j*eydt*sinf(w*dt + p);
+    }
+    else // Over Damped
+    {
+        const float y0 = (d + sqrtf(d*d - 4*s)) / 2.0f;
+        const float y1 = (d - sqrtf(d*d - 4*s)) / 2.0f;
+        float j1 = (c*y0 - x*y0 - v) / (y1 - y0);
+        float j0 = x - j1 - c;
+        
+        float ey0dt = fast_negexp(y0*dt);
+        float ey1dt = fast_negexp(y1*dt);
+
+        x =  j0*ey0dt + j1*ey1dt + c;
+        v = -y0*j0*ey0dt - y1*j1*ey1dt;
+    }
+}
+
+template<typename Tuning>
+void simple_spring_damper_exact_fixed(
+    float& x, 
+    float& v, 
+    float x_goal, 
+    float dt)
+{
+    constexpr float y = halflife_to_damping(Tuning::halflife) / 2.0f;	
+    float j0 = x - x_goal;
+    float j1 = v + j0*y;
+    float eydt = fast_negexp(y*dt);
+
+    x = eydt*(j0 + j1*dt) + x_goal;
+    v = eydt*(v - j1*y*dt);
+}
+
+//--------------------------------------
+
+constexpr float halflife_to_lag(float halflife)
 {
     return halflife / 0.69314718056f;
 }
 
-float lag_to_halflife(float lag)
+constexpr float lag_to_halflife(float lag)
 {
     return lag * 0.69314718056f;
 }
 
 //--------------------------------------
+
+// Versions of the main solvers templated on the type used for the state
+// `S` and the type used for the coefficients `C`. As well as all `float`
+// or all `double` this allows `double` state with `float` coefficients, 
+// which keeps precision for springs far from the origin (such as those
+// in world space) while computing the decay in single precision. These
+// use a critically damped test relative to the stiffness so that it
+// still works for very stiff springs. With all `float` arguments the 
+// non-template versions above get picked, so the template arguments
+// should be given explicitly, e.g. `simple_spring_damper_exact<double, float>`.
+
+constexpr double fast_negexp(double x)
+{
+    return 1.0 / (1.0 + x + 0.48*x*x + 0.235*x*x*x);
+}
+
+double fast_atan(double x)
+{
+    double z = fabs(x);
+    double w = z > 1.0 ? 1.0 / z : z;
+    double y = (M_PI / 4.0)*w - w*(w - 1)*(0.2447 + 0.0663*w);
+    return copysign(z > 1.0 ? M_PI / 2.0 - y : y, x);
+}
+
+template<typename S, typename C>
+S damper_exact(S x, S g, C halflife, C dt, C eps = C(1e-5))
+{
+    C a = fast_negexp((C(0.69314718056) * dt) / (halflife + eps));
+    return g + (x - g) * a;
+}
+
+template<typename S, typename C>
+void simple_spring_damper_exact(
+    S& x, 
+    S& v, 
+    S x_goal, 
+    C halflife, 
+    C dt, 
+    C eps = C(1e-5))
+{
+    C y = C(2.0 * 0.69314718056) / (halflife + eps);
+    C eydt = fast_negexp(y*dt);
+    S j0 = x - x_goal;
+    S j1 = v + j0*y;
+
+    x = eydt*(j0 + j1*dt) + x_goal;
+    v = eydt*(v - j1*y*dt);
+}
+
+template<typename S, typename C>
+void simple_spring_damper_exact_batch(
+    S x[], 
+    S v[], 
+    const S x_goal[], 
+    int count,
+    C halflife, 
+    C dt, 
+    C eps = C(1e-5))
+{
+    C y = C(2.0 * 0.69314718056) / (halflife + eps);
+    C eydt = fast_negexp(y*dt);
+    
+    for (int i = 0; i < count; i++)
+    {
+        S j0 = x[i] - x_goal[i];
+        S j1 = v[i] + j0*y;
+
+        x[i] = eydt*(j0 + j1*dt) + x_goal[i];
+        v[i] = eydt*(v[i] - j1*y*dt);
+    }
+}
+
+template<typename S, typename C>
+void critical_spring_damper_exact(
+    S& x, 
+    S& v, 
+    S x_goal, 
+    S v_goal, 
+    C halflife, 
+    C dt, 
+    C eps = C(1e-5))
+{
+    C d = C(4.0 * 0.69314718056) / (halflife + eps);
+    C y = d / C(2);
+    C eydt = fast_negexp(y*dt);
+    S c = x_goal + (v_goal * d) / ((d*d) / C(4));
+    S j0 = x - c;
+    S j1 = v + j0*y;
+
+    x = eydt*(j0 + j1*dt) + c;
+    v = eydt*(v - j1*y*dt);
+}
+
+template<typename S, typename C>
+void spring_damper_exact(
+    S& x, 
+    S& v, 
+    S x_goal, 
+    S v_goal, 
+    C frequency, 
+    C halflife, 
+    C dt, 
+    C eps = C(1e-5))
+{
+    C s = (C(2.0 * M_PI) * frequency) * (C(2.0 * M_PI) * frequency);
+    C d = C(4.0 * 0.69314718056) / (halflife + eps);
+    C y = d / C(2);
+    C r = s - (d*d) / C(4);
+    S c = x_goal + (v_goal * d) / (s + eps);
+    
+    if (fabs(r) < eps * (s + C(1))) // Critically Damped
+    {
+        S j0 = x - c;
+        S j1 = v + j0*y;
+        
+        C eydt = fast_negexp(y*dt);
+        
+        x = eydt*(j0 + j1*dt) + c;
+        v = eydt*(v - j1*y*dt);
+    }
+    else if (r > C(0)) // Under Damped
+    {
+        C w = sqrt(r);
+        S j = sqrt((v + y*(x - c))*(v + y*(x - c)) / (w*w + eps) + (x - c)*(x - c));
+        S p = fast_atan((v + (x - c) * y) / (-(x - c)*w + eps));
+        
+        j = (x - c) > S(0) ? j : -j;
+        
+        C eydt = fast_negexp(y*dt);
+        
+        x = j*eydt*cos(w*dt + p) + c;
+        v = -y*j*eydt*cos(w*dt + p) - w*j*eydt*sin(w*dt + p);
+    }
+    else // Over Damped
+    {
+        C y0 = (d + sqrt(d*d - C(4)*s)) / C(2);
+        C y1 = (d - sqrt(d*d - C(4)*s)) / C(2);
+        S j1 = (c*y0 - x*y0 - v) / (y1 - y0);
+        S j0 = x - j1 - c;
+        
+        C ey0dt = fast_negexp(y0*dt);
+        C ey1dt = fast_negexp(y1*dt);
+
+        x =  j0*ey0dt + j1*ey1dt + c;
+        v = -y0*j0*ey0dt - y1*j1*ey1dt;
+    }
+}
+
+//--------------------------------------
+
+// Fixed point versions of the simpler solvers, using 16.16 
+// numbers stored in an `int`. These only use integer 
+// operations so give bit-identical results on every platform 
+// and with every compiler flag, which is what is needed for 
+// lockstep simulation. All arguments, including `halflife` 
+// and `dt`, should be given in this format. The range is 
+// about +/-32768 so positions may need scaling down first.
+
+enum
+{
+    Q16_SHIFT = 16,
+    Q16_ONE = 1 << Q16_SHIFT,
+    Q16_LN2 = 45426,            // ln(2) in 16.16
+    Q16_NEGEXP_MAX = 64 << 16,  // Beyond this negexp is below one unit
+    Q16_HALFLIFE_MIN = 64,      // About 1ms, keeps the damping in range
+};
+
+constexpr int q16_from_float(float x)
+{
+    return (int)(x * Q16_ONE + (x >= 0.0f ? 0.5f : -0.5f));
+}
+
+constexpr float q16_to_float(int x)
+{
+    return (float)x / Q16_ONE;
+}
+
+constexpr int q16_mul(int a, int b)
+{
+    return (int)(((long long)a * b) >> Q16_SHIFT);
+}
+
+constexpr int q16_div(int a, int b)
+{
+    return (int)(((long long)a * Q16_ONE) / b);
+}
+
+// Same rational approximation as `fast_negexp`
+int q16_negexp(int x)
+{
+    if (x >= Q16_NEGEXP_MAX) { return 0; }
+    if (x <= 0) { return Q16_ONE; }
+    
+    long long x1 = x;
+    long long x2 = (x1 * x1) >> Q16_SHIFT;
+    long long x3 = (x2 * x1) >> Q16_SHIFT;
+    long long d = Q16_ONE + x1 + 
+        ((x2 * 31457) >> Q16_SHIFT) +  // 0.48
+        ((x3 * 15401) >> Q16_SHIFT);   // 0.235
+    
+    return (int)(((long long)Q16_ONE << Q16_SHIFT) / d);
+}
+
+constexpr int q16_halflife_to_damping(int halflife)
+{
+    return q16_div(4 * Q16_LN2, (halflife > Q16_HALFLIFE_MIN ? halflife : Q16_HALFLIFE_MIN) + 1);
+}
+
+int damper_exact_q16(int x, int g, int halflife, int dt)
+{
+    int a = q16_negexp(q16_mul(q16_halflife_to_damping(halflife) / 4, dt));
+    return g + q16_mul(x - g, a);
+}
+
+void simple_spring_damper_exact_q16(
+    int& x, 
+    int& v, 
+    int x_goal, 
+    int halflife, 
+    int dt)
+{
+    int y = q16_halflife_to_damping(halflife) / 2;
+    int ydt = q16_mul(y, dt);
+    int eydt = q16_negexp(ydt);
+    int j0 = x - x_goal;
+    int j1 = v + q16_mul(j0, y);
+
+    x = q16_mul(eydt, j0 + q16_mul(j1, dt)) + x_goal;
+    v = q16_mul(eydt, v - q16_mul(j1, ydt));
+}
+
+void simple_spring_damper_exact_q16_batch(
+    int x[], 
+    int v[], 
+    const int x_goal[], 
+    int count,
+    int halflife, 
+    int dt)
+{
+    int y = q16_halflife_to_damping(halflife) / 2;
+    int ydt = q16_mul(y, dt);
+    int eydt = q16_negexp(ydt);
+    
+    for (int i = 0; i < count; i++)
+    {
+        int j0 = x[i] - x_goal[i];
+        int j1 = v[i] + q16_mul(j0, y);
+
+        x[i] = q16_mul(eydt, j0 + q16_mul(j1, dt)) + x_goal[i];
+        v[i] = q16_mul(eydt, v[i] - q16_mul(j1, ydt));
+    }
+}
+
+void critical_spring_damper_exact_q16(
+    int& x, 
+    int& v, 
+    int x_goal, 
+    int v_goal, 
+    int halflife, 
+    int dt)
+{
+    int d = q16_halflife_to_damping(halflife);
+    int y = d / 2;
+    int ydt = q16_mul(y, dt);
+    int eydt = q16_negexp(ydt);
+    int c = x_goal + 4 * q16_div(v_goal, d);
+    int j0 = x - c;
+    int j1 = v + q16_mul(j0, y);
+
+    x = q16_mul(eydt, j0 + q16_mul(j1, dt)) + c;
+    v = q16_mul(eydt, v - q16_mul(j1, ydt));
+}
+
+// Runs each of the fixed point solvers for 600 frames toward a 
+// triangle wave goal and compares a hash of the results against 
+// the value they give on a reference build. Returns false if this
+// build of the solvers is not bit-identical to the reference.
+bool q16_determinism_check()
+{
+    int halflife = Q16_ONE / 5;
+    int dt = Q16_ONE / 60;
+    int xs = 0, vs = 0, xc = 0, vc = 0, xd = 0;
+    unsigned int hash = 0;
+    
+    for (int i = 0; i < 600; i++)
+    {
+        int phase = i % 120;
+        int goal = (phase < 60 ? phase : 120 - phase) * 2 * Q16_ONE - 60 * Q16_ONE;
+        
+        simple_spring_damper_exact_q16(xs, vs, goal, halflife, dt);
+        critical_spring_damper_exact_q16(xc, vc, goal, 5 * Q16_ONE, halflife, dt);
+        xd = damper_exact_q16(xd, goal, halflife, dt);
+        
+        hash = hash * 31u + (unsigned int)xs;
+        hash = hash * 31u + (unsigned int)vs;
+        hash = hash * 31u + (unsigned int)xc;
+        hash = hash * 31u + (unsigned int)vc;
+        hash = hash * 31u + (unsigned int)xd;
+    }
+    
+    return hash == 0xd376592eu;
+}
+
+//--------------------------------------
+
+// Conversion to and from the bits of a 16-bit half 
+// precision float, rounding to nearest even. When built 
+// with F16C support this uses the hardware conversions.
+
+unsigned short half_from_float(float f)
+{
+#ifdef __F16C__
+    return _cvtss_sh(f, 0);
+#else
+    unsigned int u;
+    memcpy(&u, &f, sizeof(float));
+    unsigned int sign = u & 0x80000000u;
+    u ^= sign;
+    
+    unsigned short o;
+    if (u >= (143u << 23)) // Too large, Inf or NaN
+    {
+        o = u > (255u << 23) ? 0x7e00 : 0x7c00;
+    }
+    else if (u < (113u << 23)) // Denormal or zero
+    {
+        unsigned int magic_u = 126u << 23;
+        float magic, fu;
+        memcpy(&magic, &magic_u, sizeof(float));
+        memcpy(&fu, &u, sizeof(float));
+        fu += magic;
+        memcpy(&u, &fu, sizeof(float));
+        o = (unsigned short)(u - magic_u);
+    }
+    else
+    {
+        unsigned int mant_odd = (u >> 13) & 1;
+        u -= 112u << 23;
+        u += 0xfff + mant_odd;
+        o = (unsigned short)(u >> 13);
+    }
+    
+    return o | (unsigned short)(sign >> 16);
+#endif
+}
+
+float half_to_float(unsigned short h)
+{
+#ifdef __F16C__
+    return _cvtsh_ss(h);
+#else
+    unsigned int o = (h & 0x7fffu) << 13;
+    unsigned int exp = o & (0x7c00u << 13);
+    o += 112u << 23;
+    
+    if (exp == (0x7c00u << 13)) // Inf or NaN
+    {
+        o += 112u << 23;
+    }
+    else if (exp == 0) // Denormal or zero
+    {
+        unsigned int magic_u = 113u << 23;
+        float magic, fo;
+        memcpy(&magic, &magic_u, sizeof(float));
+        o += 1u << 23;
+        memcpy(&fo, &o, sizeof(float));
+        fo -= magic;
+        memcpy(&o, &fo, sizeof(float));
+    }
+    
+    o |= (h & 0x8000u) << 16;
+    
+    float f;
+    memcpy(&f, &o, sizeof(float));
+    return f;
+#endif
+}
+
+// Velocities stored as a fraction of `v_range` in a `short`
+constexpr short velocity_quantize(float v, float v_range)
+{
+    return (short)(clamp(v / v_range, -1.0f, 1.0f) * 32767.0f + (v >= 0.0f ? 0.5f : -0.5f));
+}
+
+constexpr float velocity_dequantize(short q, float v_range)
+{
+    return q * (v_range / 32767.0f);
+}
+
+// Version of `simple_spring_damper_exact` for large pools where
+// precision matters less than memory bandwidth. The goal and 
+// halflife are stored as half precision floats and the velocity
+// is quantized, giving 10 bytes per spring instead of 16. The 
+// position is kept as a full float since that is what is read
+// by whatever uses the spring. When built with F16C and AVX2 
+// eight springs are unpacked and updated at once in registers.
+void simple_spring_damper_exact_batch_compressed(
+    float x[],
+    short v[],
+    const unsigned short x_goal[],
+    const unsigned short halflife[],
+    int count,
+    float v_range,
+    float dt)
+{
+    int i = 0;
+    
+#if defined(__F16C__) && defined(__AVX2__)
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 dt8 = _mm256_set1_ps(dt);
+    __m256 eps8 = _mm256_set1_ps(1e-5f);
+    __m256 ln2x2 = _mm256_set1_ps(2.0f * 0.69314718056f);
+    __m256 v_scale = _mm256_set1_ps(v_range / 32767.0f);
+    __m256 v_scale_inv = _mm256_set1_ps(32767.0f / v_range);
+    __m256 q_max = _mm256_set1_ps(32767.0f);
+    __m256 q_min = _mm256_set1_ps(-32767.0f);
+    __m256 half = _mm256_set1_ps(0.5f);
+    __m256 sign = _mm256_set1_ps(-0.0f);
+    
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 xi = _mm256_loadu_ps(x + i);
+        __m256 gi = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(x_goal + i)));
+        __m256 hi = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(halflife + i)));
+        __m256 vi = _mm256_mul_ps(v_scale, _mm256_cvtepi32_ps(
+            _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(v + i)))));
+        
+        // Same as `simple_spring_damper_exact` with `fast_negexp`
+        __m256 y = _mm256_div_ps(ln2x2, _mm256_add_ps(hi, eps8));
+        __m256 ydt = _mm256_mul_ps(y, dt8);
+        __m256 eydt = _mm256_div_ps(one, _mm256_add_ps(one, _mm256_mul_ps(ydt, 
+            _mm256_add_ps(one, _mm256_mul_ps(ydt, 
+            _mm256_add_ps(_mm256_set1_ps(0.48f), _mm256_mul_ps(ydt, _mm256_set1_ps(0.235f))))))));
+        
+        __m256 j0 = _mm256_sub_ps(xi, gi);
+        __m256 j1 = _mm256_add_ps(vi, _mm256_mul_ps(j0, y));
+        
+        xi = _mm256_add_ps(_mm256_mul_ps(eydt, _mm256_add_ps(j0, _mm256_mul_ps(j1, dt8))), gi);
+        vi = _mm256_mul_ps(eydt, _mm256_sub_ps(vi, _mm256_mul_ps(j1, ydt)));
+        
+        // Same as `velocity_quantize`
+        __m256 q = _mm256_mul_ps(vi, v_scale_inv);
+        q = _mm256_min_ps(_mm256_max_ps(q, q_min), q_max);
+        q = _mm256_add_ps(q, _mm256_or_ps(half, _mm256_and_ps(q, sign)));
+        __m256i qi = _mm256_cvttps_epi32(q);
+        
+        _mm256_storeu_ps(x + i, xi);
+        _mm_storeu_si128((__m128i*)(v + i), _mm_packs_epi32(
+            _mm256_castsi256_si128(qi), _mm256_extracti128_si256(qi, 1)));
+    }
+#endif
+    
+    for (; i < count; i++)
+    {
+        float xi = x[i];
+        float vi = velocity_dequantize(v[i], v_range);
+        
+        simple_spring_damper_exact(
+            xi, vi, half_to_float(x_goal[i]), half_to_float(halflife[i]), dt);
+        
+        x[i] = xi;
+        v[i] = velocity_quantize(vi, v_range);
+    }
+}
+
+//--------------------------------------
+
+// Array of structures of arrays layout for large pools. Each 
+// block keeps all the fields for a small group of springs next 
+// to each other in memory, so an update reads one contiguous 
+// stream rather than one stream per field. Spring `i` lives in
+// block `i / SPRING_BLOCK_SIZE` at index `i % SPRING_BLOCK_SIZE`.
+// Blocks should only be updated with the `_blocks` functions 
+// below, since the other batch functions don't know about the 
+// per-spring `halflife` each block stores.
+
+enum
+{
+    SPRING_BLOCK_SIZE = 8,
+};
+
+constexpr int spring_block_count(int count)
+{
+    return (count + SPRING_BLOCK_SIZE - 1) / SPRING_BLOCK_SIZE;
+}
+
+struct simple_spring_block
+{
+    float x[SPRING_BLOCK_SIZE];
+    float v[SPRING_BLOCK_SIZE];
+    float x_goal[SPRING_BLOCK_SIZE];
+    float halflife[SPRING_BLOCK_SIZE];
+};
+
+struct spring_damper_block
+{
+    float x[SPRING_BLOCK_SIZE];
+    float v[SPRING_BLOCK_SIZE];
+    float x_goal[SPRING_BLOCK_SIZE];
+    float v_goal[SPRING_BLOCK_SIZE];
+    float frequency[SPRING_BLOCK_SIZE];
+    float halflife[SPRING_BLOCK_SIZE];
+};
+
+// Here `count` is the number of springs, not blocks
+void simple_spring_damper_exact_blocks(
+    simple_spring_block blocks[],
+    int count,
+    float dt)
+{
+    for (int b = 0; b < spring_block_count(count); b++)
+    {
+        simple_spring_block& block = blocks[b];
+        int n = count - b * SPRING_BLOCK_SIZE;
+        n = n < SPRING_BLOCK_SIZE ? n : SPRING_BLOCK_SIZE;
+        
+        for (int i = 0; i < n; i++)
+        {
+            simple_spring_damper_exact(
+                block.x[i], block.v[i], block.x_goal[i], block.halflife[i], dt);
+        }
+    }
+}
+
+void spring_damper_exact_blocks(
+    spring_damper_block blocks[],
+    int count,
+    float dt)
+{
+    for (int b = 0; b < spring_block_count(count); b++)
+    {
+        spring_damper_block& block = blocks[b];
+        int n = count - b * SPRING_BLOCK_SIZE;
+        n = n < SPRING_BLOCK_SIZE ? n : SPRING_BLOCK_SIZE;
+        
+        for (int i = 0; i < n; i++)
+        {
+            spring_damper_exact(
+                block.x[i], block.v[i], 
+                block.x_goal[i], block.v_goal[i], 
+                block.frequency[i], block.halflife[i], 
+                dt);
+        }
+    }
+}
+
+//--------------------------------------
+
+// Level of detail scheduling for springs. Less important 
+// springs are only updated every 2, 4 or 8 frames, staggered 
+// so that the work is spread evenly. Because the exact 
+// solvers work for any `dt` the time accumulated since the 
+// last update is simply passed when they do run. So that
+// reads on the frames in-between are smooth, each update also
+// predicts the position one period ahead, which reads can 
+// interpolate toward.
+
+enum
+{
+    SPRING_LOD_MAX = 1024,
+    SPRING_LOD_LEVELS = 4,
+};
+
+struct spring_lod
+{
+    int frame;
+    int period[SPRING_LOD_MAX];     // Frames between updates
+    float elapsed[SPRING_LOD_MAX];  // Time since the last update
+    float span[SPRING_LOD_MAX];     // Time predicted ahead at the last update
+};
+
+void spring_lod_init(spring_lod& lod)
+{
+    lod.frame = 0;
+    for (int i = 0; i < SPRING_LOD_MAX; i++)
+    {
+        lod.period[i] = 1;
+        lod.elapsed[i] = 0.0f;
+        lod.span[i] = 0.0f;
+    }
+}
+
+// Importance of one or more updates every frame, down 
+// to zero or less updating every 8 frames
+constexpr int spring_lod_period(float importance)
+{
+    return 1 << (int)min(
+        (1.0f - clamp(importance, 0.0f, 1.0f)) * SPRING_LOD_LEVELS, 
+        SPRING_LOD_LEVELS - 1.0f);
+}
+
+// Fills `due` with the springs to update this frame and `due_dt`
+// with the time to update each by, returning how many there are.
+// Since periods are powers of two a spring which becomes more 
+// important is updated within its new period. Returns -1 if 
+// `count` is more than `SPRING_LOD_MAX`.
+int spring_lod_schedule(
+    spring_lod& lod,
+    int due[],
+    float due_dt[],
+    const float importance[],
+    int count,
+    float dt)
+{
+    if (count < 0 || count > SPRING_LOD_MAX)
+    {
+        return -1;
+    }
+    
+    int ndue = 0;
+    for (int i = 0; i < count; i++)
+    {
+        lod.elapsed[i] += dt;
+        lod.period[i] = spring_lod_period(importance[i]);
+        
+        if (((lod.frame + i) & (lod.period[i] - 1)) == 0)
+        {
+            due[ndue] = i;
+            due_dt[ndue] = lod.elapsed[i];
+            ndue++;
+            
+            lod.elapsed[i] = 0.0f;
+            lod.span[i] = lod.period[i] * dt;
+        }
+    }
+    
+    lod.frame++;
+    return ndue;
+}
+
+// Interpolates from the position at the last update toward 
+// the position predicted one period ahead
+float spring_lod_read(
+    const float x[],
+    const float x_next[],
+    const spring_lod& lod,
+    int i)
+{
+    float alpha = lod.span[i] > 0.0f ? 
+        min(lod.elapsed[i] / lod.span[i], 1.0f) : 0.0f;
+    
+    return lerp(x[i], x_next[i], alpha);
+}
+
+// Returns false if `count` is more than `SPRING_LOD_MAX`
+bool critical_spring_damper_exact_lod(
+    float x[],
+    float v[],
+    float x_next[],
+    const float x_goal[],
+    const float v_goal[],
+    const float halflife[],
+    const float importance[],
+    spring_lod& lod,
+    int count,
+    float dt)
+{
+    int due[SPRING_LOD_MAX];
+    float due_dt[SPRING_LOD_MAX];
+    int ndue = spring_lod_schedule(lod, due, due_dt, importance, count, dt);
+    if (ndue < 0)
+    {
+        return false;
+    }
+    
+    for (int k = 0; k < ndue; k++)
+    {
+        int i = due[k];
+        
+        critical_spring_damper_exact(
+            x[i], v[i], x_goal[i], v_goal[i], halflife[i], due_dt[k]);
+        
+        float v_next = v[i];
+        x_next[i] = x[i];
+        
+        critical_spring_damper_exact(
+            x_next[i], v_next, x_goal[i], v_goal[i], halflife[i], lod.span[i]);
+    }
+    
+    return true;
+}
+
+//--------------------------------------
+
+// Predicts when a critically damped spring will next cross 
+// `threshold`, using the closed form of its position over time.
+// The offset from the goal changes direction at most once, so 
+// there are at most two monotonic sections, each of which can be
+// searched for a crossing by bisection. Returns the time after
+// the given state at which the spring has just passed the 
+// threshold, or a negative value if it never crosses after `t_from`.
+float critical_spring_offset(float j0, float j1, float y, float t)
+{
+    return expf(-y*t) * (j0 + j1*t);
+}
+
+// Same closed form as `critical_spring_damper_exact` but using 
+// `expf` so that it agrees with the predicted crossing times
+void critical_spring_closed_form(
+    float& x, 
+    float& v, 
+    float x_goal, 
+    float v_goal, 
+    float halflife, 
+    float t,
+    float eps = 1e-5f)
+{
+    float d = halflife_to_damping(halflife, eps);
+    float y = d / 2.0f;
+    float c = x_goal + (v_goal * d) / ((d*d) / 4.0f);
+    float j0 = x - c;
+    float j1 = v + j0*y;
+    float eyt = expf(-y*t);
+    
+    x = eyt*(j0 + j1*t) + c;
+    v = eyt*(v - j1*y*t);
+}
+
+float critical_spring_crossing_time(
+    float x, 
+    float v, 
+    float x_goal, 
+    float v_goal, 
+    float halflife, 
+    float threshold,
+    float t_from = 0.0f,
+    int iterations = 32,
+    float eps = 1e-5f)
+{
+    float d = halflife_to_damping(halflife, eps);
+    float y = d / 2.0f;
+    float c = x_goal + (v_goal * d) / ((d*d) / 4.0f);
+    float j0 = x - c;
+    float j1 = v + j0*y;
+    float k = threshold - c;
+    
+    float t_turn = fabs(j1) > eps ? 1.0f / y - j0 / j1 : -1.0f;
+    
+    float a = t_from;
+    float fa = critical_spring_offset(j0, j1, y, a) - k;
+    
+    for (int section = 0; section < 2; section++)
+    {
+        float b, fb;
+        bool last = !(t_turn > a);
+        
+        if (!last)
+        {
+            b = t_turn;
+            fb = critical_spring_offset(j0, j1, y, b) - k;
+        }
+        else
+        {
+            // Final section tends toward `-k` so only crosses if
+            // it starts on the other side of the threshold
+            if (fa * -k >= 0.0f) { return -1.0f; }
+            
+            b = a + 1.0f / y;
+            fb = critical_spring_offset(j0, j1, y, b) - k;
+            for (int i = 0; i < 64 && fa * fb > 0.0f; i++)
+            {
+                b = a + 2.0f * (b - a);
+                fb = critical_spring_offset(j0, j1, y, b) - k;
+            }
+        }
+        
+        if ((fa < 0.0f && fb >= 0.0f) || (fa > 0.0f && fb <= 0.0f))
+        {
+            float lo = a, hi = b;
+            for (int i = 0; i < iterations; i++)
+            {
+                float mid = (lo + hi) / 2.0f;
+                float fm = critical_spring_offset(j0, j1, y, mid) - k;
+                if ((fm < 0.0f) == (fa < 0.0f)) { lo = mid; } else { hi = mid; }
+            }
+            return hi;
+        }
+        
+        if (last) { return -1.0f; }
+        
+        a = b;
+        fa = fb;
+    }
+    
+    return -1.0f;
+}
+
+// Fires callbacks when critically damped springs cross registered
+// thresholds without polling them every frame. The state of each 
+// spring is stored at the time its goal or parameters last changed,
+// from which the crossing time of each of its thresholds is 
+// predicted and kept in a binary heap ordered by time. Crossing 
+// times are only recomputed when a spring is changed or one of its
+// thresholds fires. Crossing times are found relative to when the 
+// spring was last changed, and the clock is kept in double precision,
+// so they stay accurate however long the scheduler has been running.
+
+enum
+{
+    SPRING_EVENT_SPRINGS_MAX = 256,
+    SPRING_EVENT_THRESHOLDS_MAX = 1024,
+};
+
+typedef void (*spring_event_callback)(int spring, int threshold, double time, void* user);
+
+struct spring_event_scheduler
+{
+    // State of each spring when it was last changed
+    int nsprings;
+    float x[SPRING_EVENT_SPRINGS_MAX];
+    float v[SPRING_EVENT_SPRINGS_MAX];
+    float x_goal[SPRING_EVENT_SPRINGS_MAX];
+    float v_goal[SPRING_EVENT_SPRINGS_MAX];
+    float halflife[SPRING_EVENT_SPRINGS_MAX];
+    double time[SPRING_EVENT_SPRINGS_MAX];
+    int changes[SPRING_EVENT_SPRINGS_MAX];             // Number of times spring was changed
+    
+    int nthresholds;
+    int threshold_spring[SPRING_EVENT_THRESHOLDS_MAX];
+    float threshold_value[SPRING_EVENT_THRESHOLDS_MAX];
+    float threshold_after[SPRING_EVENT_THRESHOLDS_MAX]; // Time of next crossing after spring was changed
+    double threshold_time[SPRING_EVENT_THRESHOLDS_MAX]; // Absolute time of next crossing
+    int heap_index[SPRING_EVENT_THRESHOLDS_MAX];       // Position in heap or -1
+    
+    int nheap;
+    int heap[SPRING_EVENT_THRESHOLDS_MAX];             // Thresholds ordered by crossing time
+};
+
+void spring_event_scheduler_init(spring_event_scheduler& sched)
+{
+    sched.nsprings = 0;
+    sched.nthresholds = 0;
+    sched.nheap = 0;
+}
+
+void spring_event_heap_swap(spring_event_scheduler& sched, int i, int j)
+{
+    int ti = sched.heap[i];
+    int tj = sched.heap[j];
+    sched.heap[i] = tj;
+    sched.heap[j] = ti;
+    sched.heap_index[tj] = i;
+    sched.heap_index[ti] = j;
+}
+
+void spring_event_heap_fix(spring_event_scheduler& sched, int i)
+{
+    while (i > 0 && 
+        sched.threshold_time[sched.heap[i]] < 
+        sched.threshold_time[sched.heap[(i - 1) / 2]])
+    {
+        spring_event_heap_swap(sched, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    
+    while (true)
+    {
+        int smallest = i;
+        int l = 2 * i + 1;
+        int r = 2 * i + 2;
+        
+        if (l < sched.nheap && sched.threshold_time[sched.heap[l]] < sched.threshold_time[sched.heap[smallest]]) { smallest = l; }
+        if (r < sched.nheap && sched.threshold_time[sched.heap[r]] < sched.threshold_time[sched.heap[smallest]]) { smallest = r; }
+        if (smallest == i) { break; }
+        
+        spring_event_heap_swap(sched, i, smallest);
+        i = smallest;
+    }
+}
+
+void spring_event_heap_remove(spring_event_scheduler& sched, int threshold)
+{
+    int i = sched.heap_index[threshold];
+    if (i < 0) { return; }
+    
+    sched.nheap--;
+    if (i != sched.nheap)
+    {
+        spring_event_heap_swap(sched, i, sched.nheap);
+        sched.heap_index[threshold] = -1;
+        spring_event_heap_fix(sched, i);
+    }
+    else
+    {
+        sched.heap_index[threshold] = -1;
+    }
+}
+
+// Predicts the next crossing of a threshold after `t_from` (a time
+// relative to when its spring was last changed) and inserts, moves 
+// or removes it in the heap
+void spring_event_predict(spring_event_scheduler& sched, int threshold, float t_from)
+{
+    int s = sched.threshold_spring[threshold];
+    float t = critical_spring_crossing_time(
+        sched.x[s], sched.v[s], 
+        sched.x_goal[s], sched.v_goal[s], 
+        sched.halflife[s], 
+        sched.threshold_value[threshold],
+        t_from);
+    
+    if (t < 0.0f)
+    {
+        spring_event_heap_remove(sched, threshold);
+        return;
+    }
+    
+    sched.threshold_after[threshold] = t;
+    sched.threshold_time[threshold] = sched.time[s] + t;
+    
+    if (sched.heap_index[threshold] < 0)
+    {
+        sched.heap[sched.nheap] = threshold;
+        sched.heap_index[threshold] = sched.nheap;
+        sched.nheap++;
+    }
+    
+    spring_event_heap_fix(sched, sched.heap_index[threshold]);
+}
+
+void spring_event_set_spring(
+    spring_event_scheduler& sched,
+    int spring,
+    float x,
+    float v,
+    float x_goal,
+    float v_goal,
+    float halflife,
+    double time)
+{
+    sched.x[spring] = x;
+    sched.v[spring] = v;
+    sched.x_goal[spring] = x_goal;
+    sched.v_goal[spring] = v_goal;
+    sched.halflife[spring] = halflife;
+    sched.time[spring] = time;
+    sched.changes[spring]++;
+    
+    for (int i = 0; i < sched.nthresholds; i++)
+    {
+        if (sched.threshold_spring[i] == spring)
+        {
+            spring_event_predict(sched, i, 0.0f);
+        }
+    }
+}
+
+int spring_event_add_spring(
+    spring_event_scheduler& sched,
+    float x,
+    float v,
+    float x_goal,
+    float v_goal,
+    float halflife,
+    double time)
+{
+    if (sched.nsprings >= SPRING_EVENT_SPRINGS_MAX)
+    {
+        return -1;
+    }
+    
+    int s = sched.nsprings++;
+    sched.changes[s] = 0;
+    spring_event_set_spring(sched, s, x, v, x_goal, v_goal, halflife, time);
+    return s;
+}
+
+int spring_event_add_threshold(
+    spring_event_scheduler& sched,
+    int spring,
+    float threshold,
+    double time)
+{
+    if (sched.nthresholds >= SPRING_EVENT_THRESHOLDS_MAX)
+    {
+        return -1;
+    }
+    
+    int i = sched.nthresholds++;
+    sched.threshold_spring[i] = spring;
+    sched.threshold_value[i] = threshold;
+    sched.heap_index[i] = -1;
+    
+    double t_from = time - sched.time[spring];
+    spring_event_predict(sched, i, t_from > 0.0 ? (float)t_from : 0.0f);
+    return i;
+}
+
+// Evaluates the position and velocity of a spring at `time`
+void spring_event_spring_state(
+    const spring_event_scheduler& sched,
+    float& x,
+    float& v,
+    int spring,
+    double time)
+{
+    x = sched.x[spring];
+    v = sched.v[spring];
+    critical_spring_closed_form(
+        x, v, 
+        sched.x_goal[spring], sched.v_goal[spring], 
+        sched.halflife[spring], 
+        (float)(time - sched.time[spring]));
+}
+
+// Fires the callback for every crossing up to `time` in order. 
+// After firing, the next crossing is searched for from the one
+// which fired and must come strictly after it, unless the callback
+// changed the spring, in which case it has already been predicted.
+void spring_event_update(
+    spring_event_scheduler& sched,
+    double time,
+    spring_event_callback callback,
+    void* user)
+{
+    while (sched.nheap > 0 && sched.threshold_time[sched.heap[0]] <= time)
+    {
+        int threshold = sched.heap[0];
+        int spring = sched.threshold_spring[threshold];
+        int changes = sched.changes[spring];
+        float after = sched.threshold_after[threshold];
+        
+        callback(spring, threshold, sched.threshold_time[threshold], user);
+        
+        if (sched.changes[spring] != changes)
+        {
+            continue;
+        }
+        
+        spring_event_predict(sched, threshold, after);
+        
+        if (sched.heap_index[threshold] >= 0 && sched.threshold_after[threshold] <= after)
+        {
+            spring_event_heap_remove(sched, threshold);
+        }
+    }
+}
+
+//--------------------------------------
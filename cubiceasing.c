@@ -36,6 +36,118 @@ float cubic_dt(float t, float v, float g)
     }
 }
 
+//--------------------------------------
+
+enum
+{
+    CUBIC_POOL_MAX = 4096
+};
+
+// Pool of cubic eased values stored as separate arrays. Only values
+// which are still easing are kept in the active list, and they are 
+// removed from it once their time passes one, so finished values 
+// cost nothing to update.
+struct cubic_easing_pool
+{
+    int count;
+    int nactive;
+    int active[CUBIC_POOL_MAX];      // Indices of values still easing
+    int active_slot[CUBIC_POOL_MAX]; // Location in `active` or -1
+    float x[CUBIC_POOL_MAX];  // Eased value
+    float g[CUBIC_POOL_MAX];  // Target
+    float ct[CUBIC_POOL_MAX]; // Cubic time
+    float cv[CUBIC_POOL_MAX]; // Cubic velocity
+    float co[CUBIC_POOL_MAX]; // Cubic offset
+};
+
+// Returns false if `count` is more than `CUBIC_POOL_MAX`
+bool cubic_easing_pool_init(cubic_easing_pool& pool, int count, float x)
+{
+    if (count < 0 || count > CUBIC_POOL_MAX)
+    {
+        return false;
+    }
+    
+    pool.count = count;
+    pool.nactive = 0;
+    for (int i = 0; i < count; i++)
+    {
+        pool.active_slot[i] = -1;
+        pool.x[i] = x;
+        pool.g[i] = x;
+        pool.ct[i] = 1.0f;
+        pool.cv[i] = 0.0f;
+        pool.co[i] = x;
+    }
+    
+    return true;
+}
+
+void cubic_easing_pool_retarget(cubic_easing_pool& pool, int i, float g)
+{
+    if (pool.g[i] == g)
+    {
+        return;
+    }
+    
+    // Get current location and velocity
+    float nx = pool.co[i] + cubic(pool.ct[i], pool.cv[i], pool.g[i] - pool.co[i]);
+    float nv = cubic_dt(pool.ct[i], pool.cv[i], pool.g[i] - pool.co[i]);
+    
+    // Reset to the new target, offset, velocity, and time
+    pool.g[i] = g;
+    pool.co[i] = nx;
+    pool.cv[i] = nv;
+    pool.ct[i] = 0.0f;
+    
+    if (pool.active_slot[i] == -1)
+    {
+        pool.active_slot[i] = pool.nactive;
+        pool.active[pool.nactive++] = i;
+    }
+}
+
+void cubic_easing_pool_update(
+    cubic_easing_pool& pool, 
+    float blendtime, 
+    float dt)
+{
+    float ct_delta = dt / max(blendtime, 1e-4f);
+    
+    // Clamping the time to one gives the same result as 
+    // the branch in `cubic` so the loop can be vectorized
+    for (int j = 0; j < pool.nactive; j++)
+    {
+        int i = pool.active[j];
+        pool.ct[i] += ct_delta;
+        
+        float t = min(pool.ct[i], 1.0f);
+        float w1 = 3*t*t - 2*t*t*t;
+        float w2 = t*t*t - 2*t*t + t;
+        pool.x[i] = pool.co[i] + w1*(pool.g[i] - pool.co[i]) + w2*pool.cv[i];
+    }
+    
+    // Remove finished values by swapping in the last active value
+    int j = 0;
+    while (j < pool.nactive)
+    {
+        int i = pool.active[j];
+        if (pool.ct[i] >= 1.0f)
+        {
+            int last = pool.active[--pool.nactive];
+            pool.active[j] = last;
+            pool.active_slot[last] = j;
+            pool.active_slot[i] = -1;
+        }
+        else
+        {
+            j++;
+        }
+    }
+}
+
+//--------------------------------------
+
 int main(void)
 {
     // Init Window
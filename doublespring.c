@@ -15,6 +15,110 @@ void double_spring_damper_exact(
     simple_spring_damper_exact(x, v, xi, 0.5f * halflife, dt);
 }
 
+// Generalization of the double spring to a chain of `N` springs, each 
+// following the one before it, with `x[0]` following the goal and 
+// `x[N-1]` being the output. Since every stage shares the same 
+// halflife the decay only needs to be computed once, and as `N` is 
+// known at compile time the loop can be fully unrolled.
+template<int N>
+void spring_chain_damper_exact(
+    float x[N],
+    float v[N],
+    float x_goal,
+    float halflife,
+    float dt)
+{
+    float y = halflife_to_damping(halflife / N) / 2.0f;
+    float eydt = fast_negexp(y*dt);
+    float g = x_goal;
+    
+    for (int i = 0; i < N; i++)
+    {
+        float j0 = x[i] - g;
+        float j1 = v[i] + j0*y;
+        
+        x[i] = eydt*(j0 + j1*dt) + g;
+        v[i] = eydt*(v[i] - j1*y*dt);
+        g = x[i];
+    }
+}
+
+// Stepping the inner spring and then the outer spring toward the inner 
+// spring's new position is only exact for small `dt`. Since both stages
+// are critically damped with the same damping, the coupled system has 
+// a repeated root and its exact solution is the exponential decay times 
+// a polynomial in time, each stage adding two more powers of `t`. The
+// polynomial terms grow faster than `fast_negexp` decays for large 
+// `dt` so here we need to use the real exponential.
+void double_spring_damper_closed_form(
+    float& x, 
+    float& v, 
+    float& xi,
+    float& vi,
+    float x_goal,
+    float halflife, 
+    float dt)
+{
+    float y = halflife_to_damping(0.5f * halflife) / 2.0f;
+    float eydt = expf(-y*dt);
+    float t = dt;
+    
+    float a0 = xi - x_goal;
+    float a1 = vi + a0*y;
+    float b0 = x - x_goal;
+    float b1 = v + b0*y;
+    
+    float fi  = a0 + a1*t;
+    float fid = a1;
+    float f   = b0 + b1*t + y*y*(a0*t*t/2.0f + a1*t*t*t/6.0f);
+    float fd  = b1 + y*y*(a0*t + a1*t*t/2.0f);
+    
+    xi = eydt*fi + x_goal;
+    vi = eydt*(fid - y*fi);
+    x = eydt*f + x_goal;
+    v = eydt*(fd - y*f);
+}
+
+void triple_spring_damper_closed_form(
+    float& x, 
+    float& v, 
+    float& xi,
+    float& vi,
+    float& xj,
+    float& vj,
+    float x_goal,
+    float halflife, 
+    float dt)
+{
+    float y = halflife_to_damping(halflife / 3.0f) / 2.0f;
+    float eydt = expf(-y*dt);
+    float t = dt;
+    float yy = y*y;
+    
+    float a0 = xj - x_goal;
+    float a1 = vj + a0*y;
+    float b0 = xi - x_goal;
+    float b1 = vi + b0*y;
+    float c0 = x - x_goal;
+    float c1 = v + c0*y;
+    
+    float fj  = a0 + a1*t;
+    float fjd = a1;
+    float fi  = b0 + b1*t + yy*(a0*t*t/2.0f + a1*t*t*t/6.0f);
+    float fid = b1 + yy*(a0*t + a1*t*t/2.0f);
+    float f   = c0 + c1*t + yy*(b0*t*t/2.0f + b1*t*t*t/6.0f + 
+        yy*(a0*t*t*t*t/24.0f + a1*t*t*t*t*t/120.0f));
+    float fd  = c1 + yy*(b0*t + b1*t*t/2.0f + 
+        yy*(a0*t*t*t/6.0f + a1*t*t*t*t/24.0f));
+    
+    xj = eydt*fj + x_goal;
+    vj = eydt*(fjd - y*fj);
+    xi = eydt*fi + x_goal;
+    vi = eydt*(fid - y*fi);
+    x = eydt*f + x_goal;
+    v = eydt*(fd - y*f);
+}
+
 //--------------------------------------
 
 enum
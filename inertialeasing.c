@@ -26,34 +26,226 @@ float smoothstep_dt(float t, float s)
 void smoothstep_solve(
     float& t, float& s, float x, float v, float overshoot = 0.05f, float eps=1e-8f)
 {
-    // If velocity is zero start from time zero with scale to match `x`
-    if (fabsf(v) < 1e-8f)
+    // Solve for positive `x`, flipping the signs of the inputs and
+    // the resulting scale when `x` is negative
+    float sx = x < 0.0f ? -1.0f : 1.0f;
+    float ax = sx * x;
+    float av = sx * v;
+    
+    // If velocity is zero start from time zero with scale to match `x`,
+    // but still go through the solve below so that nothing branches
+    bool zero = fabsf(v) < 1e-8f;
+    
+    // Find the possible times that solve for the given `x` and `v`. These
+    // are the roots of `2v t^2 + (6x - v) t - v = 0`. The first root is
+    // written in a form which avoids cancellation when `v` is small 
+    // compared to `x`, and the second found from the product of the roots.
+    float r = sqrtf(max((6*ax - av)*(6*ax - av) + 8*av*av, eps));
+    float t0 = (2*av) / (r + 6*ax - av);
+    float t1 = -0.5f / t0;
+    
+    // Overshoot if the alternative time is between -0.5f and -(0.5f + overshoot)
+    float tf = -0.5f > t1 && t1 > -(0.5f + overshoot) ? t1 : t0;
+
+    // Find the un-scaled velocity at the fitted time
+    float vt = smoothstep_dt(tf, 1.0f);        
+
+    // Find the scaling factor so that the velocity at the fitted time matches
+    float sf = fabsf(vt) < eps ? 0.0f : av / vt;
+    
+    t = zero ? 0.0f : tf;
+    s = zero ? x : sx * sf;
+}
+
+//--------------------------------------
+
+// The solve is scale invariant: scaling both `x` and `v` scales `s`
+// by the same amount and leaves `t` unchanged, and flipping the sign
+// of both flips the sign of `s`. This means after normalizing by 
+// `|x| + |v|` the solution only depends on the normalized velocity,
+// which we can tabulate and interpolate. Cells of the table where 
+// interpolation is not accurate enough (around the switch to the 
+// overshooting solution and where `s` grows very large as `x` goes 
+// to zero) fall back to the analytic solve.
+
+enum
+{
+    SMOOTHSTEP_TABLE_SIZE = 1024,
+    SMOOTHSTEP_TABLE_CHECKS = 64,
+};
+
+struct smoothstep_table
+{
+    float overshoot;
+    float max_error;                      // Bound on the error of cells using the table
+    float t[SMOOTHSTEP_TABLE_SIZE + 1];
+    float s[SMOOTHSTEP_TABLE_SIZE + 1];   // Scale relative to `|x| + |v|`
+    bool exact[SMOOTHSTEP_TABLE_SIZE];    // If the cell uses the analytic solve
+};
+
+void smoothstep_table_build(
+    smoothstep_table& table, 
+    float overshoot = 0.05f, 
+    float tolerance = 1e-3f)
+{
+    table.overshoot = overshoot;
+    table.max_error = 0.0f;
+    
+    for (int i = 0; i <= SMOOTHSTEP_TABLE_SIZE; i++)
     {
-        t = 0.0f;
-        s = x;
-        return;
+        float b = ((float)i / SMOOTHSTEP_TABLE_SIZE) * 2.0f - 1.0f;
+        smoothstep_solve(table.t[i], table.s[i], 1.0f - fabsf(b), b, overshoot);
+    }
+    
+    // Check the interpolated values against the analytic solve at 
+    // a number of points inside each cell. The error can be larger 
+    // in-between these points, by up to an eighth of the second 
+    // difference of the solution across them, so twice this is added
+    // on. The analytic solve is itself only accurate to a few millionths
+    // of the size of its result, so a margin for that is added too.
+    for (int i = 0; i < SMOOTHSTEP_TABLE_SIZE; i++)
+    {
+        float cell_error = 0.0f;
+        float cell_curve = 0.0f;
+        float cell_scale = 1.0f;
+        float tp[2], sp[2];
+        
+        for (int j = 0; j <= SMOOTHSTEP_TABLE_CHECKS; j++)
+        {
+            float alpha = (float)j / SMOOTHSTEP_TABLE_CHECKS;
+            float b = ((i + alpha) / SMOOTHSTEP_TABLE_SIZE) * 2.0f - 1.0f;
+            
+            float t, s;
+            smoothstep_solve(t, s, 1.0f - fabsf(b), b, overshoot);
+            
+            cell_error = max(cell_error, fabsf(lerp(table.t[i], table.t[i + 1], alpha) - t));
+            cell_error = max(cell_error, fabsf(lerp(table.s[i], table.s[i + 1], alpha) - s));
+            cell_scale = max(cell_scale, max(fabsf(t), fabsf(s)));
+            
+            if (j >= 2)
+            {
+                cell_curve = max(cell_curve, fabsf(t - 2.0f*tp[1] + tp[0]));
+                cell_curve = max(cell_curve, fabsf(s - 2.0f*sp[1] + sp[0]));
+            }
+            
+            tp[0] = tp[1]; tp[1] = t;
+            sp[0] = sp[1]; sp[1] = s;
+        }
+        
+        float cell_bound = cell_error + cell_curve / 4.0f + 1e-5f * cell_scale;
+        
+        table.exact[i] = cell_bound > tolerance;
+        table.max_error = table.exact[i] ? table.max_error : max(table.max_error, cell_bound);
     }
+}
+
+void smoothstep_solve_table(
+    float& t, 
+    float& s, 
+    float x, 
+    float v, 
+    const smoothstep_table& table, 
+    float eps=1e-8f)
+{
+    float sx = x < 0.0f ? -1.0f : 1.0f;
+    float m = fabsf(x) + fabsf(v);
+    float u = ((sx * v) / max(m, eps) + 1.0f) * 0.5f * SMOOTHSTEP_TABLE_SIZE;
+    int i = min(u, SMOOTHSTEP_TABLE_SIZE - 1);
+    float alpha = u - i;
     
-    // If `x` is negative then invert signs and re-solve
-    if (x < 0.0)
+    if (table.exact[i] || m < eps)
     {
-        smoothstep_solve(t, s, -x, -v);
-        s = -s;
+        smoothstep_solve(t, s, x, v, table.overshoot);
         return;
     }
     
-    // Find the possible times that solve for the given `x` and `v`
-    float t0 = (v - 6*x + sqrtf(max((6*x - v)*(6*x - v) + 8*v*v, eps))) / (4*v);
-    float t1 = (v - 6*x - sqrtf(max((6*x - v)*(6*x - v) + 8*v*v, eps))) / (4*v);
+    t = lerp(table.t[i], table.t[i + 1], alpha);
+    s = sx * m * lerp(table.s[i], table.s[i + 1], alpha);
+}
+
+//--------------------------------------
+
+enum
+{
+    EASING_POOL_MAX = 4096
+};
+
+// Pool of inertially eased values stored as separate arrays. Only 
+// the values whose targets changed need to be re-solved, while the
+// update of all the eased values is a simple loop with no branches.
+struct inertial_easing_pool
+{
+    int count;
+    float x[EASING_POOL_MAX];  // Eased value
+    float g[EASING_POOL_MAX];  // Target
+    float et[EASING_POOL_MAX]; // Easing time
+    float es[EASING_POOL_MAX]; // Easing scale
+    float eo[EASING_POOL_MAX]; // Easing offset
+};
+
+// Returns false if `count` is more than `EASING_POOL_MAX`
+bool inertial_easing_pool_init(inertial_easing_pool& pool, int count, float x)
+{
+    if (count < 0 || count > EASING_POOL_MAX)
+    {
+        return false;
+    }
     
-    // Overshoot if the alternative time is between -0.5f and -(0.5f + overshoot)
-    t = -0.5f > t1 && t1 > -(0.5f + overshoot) ? t1 : t0;
+    pool.count = count;
+    for (int i = 0; i < count; i++)
+    {
+        pool.x[i] = x;
+        pool.g[i] = x;
+        pool.et[i] = 0.0f;
+        pool.es[i] = 0.0f;
+        pool.eo[i] = x;
+    }
+    
+    return true;
+}
 
-    // Find the un-scaled velocity at the fitted time
-    float vt = smoothstep_dt(t, 1.0f);        
+// Retargets the values at the given `indices`, skipping any 
+// whose target has not actually changed
+void inertial_easing_pool_retarget(
+    inertial_easing_pool& pool,
+    const int indices[],
+    const float targets[],
+    int count,
+    float overshoot = 0.05f)
+{
+    for (int j = 0; j < count; j++)
+    {
+        int i = indices[j];
+        
+        if (pool.g[i] == targets[j])
+        {
+            continue;
+        }
+        
+        pool.g[i] = targets[j];
+        
+        smoothstep_solve(
+            pool.et[i], pool.es[i], 
+            pool.g[i] - pool.x[i], 
+            smoothstep_dt(pool.et[i], pool.es[i]), 
+            overshoot);
+        
+        pool.eo[i] = pool.x[i] - smoothstep(pool.et[i], pool.es[i]);
+    }
+}
 
-    // Find the scaling factor so that the velocity at the fitted time matches
-    s = fabsf(vt) < eps ? 0.0f : v / vt;
+void inertial_easing_pool_update(
+    inertial_easing_pool& pool, 
+    float blendtime, 
+    float dt)
+{
+    float et_delta = dt / max(blendtime, 1e-4f);
+    
+    for (int i = 0; i < pool.count; i++)
+    {
+        pool.et[i] += et_delta;
+        pool.x[i] = pool.eo[i] + smoothstep(pool.et[i], pool.es[i]);
+    }
 }
 
 int main(void)
@@ -3,6 +3,15 @@
 
 //--------------------------------------
 
+enum
+{
+    CTRL_MAX = 8,
+    KNOT_LOOKUP_MAX = 32,
+    SUBSAMPLE_MAX = 100,
+};
+
+// Here `v` is the derivative with respect to `t`, so should be 
+// divided by the time taken to traverse the curve to get a velocity
 void piecewise_interpolation(
     float& x,
     float& v,
@@ -10,24 +19,229 @@ void piecewise_interpolation(
     float pnts[],
     int npnts)
 {
-    t = t * (npnts - 1);
-    int i0 = floorf(t);
+    t = clamp(t, 0.0f, 1.0f) * (npnts - 1);
+    int i0 = (int)t < npnts - 2 ? (int)t : npnts - 2;
     int i1 = i0 + 1;
-    i0 = i0 > npnts - 1 ? npnts - 1 : i0;
-    i1 = i1 > npnts - 1 ? npnts - 1 : i1;
-    float alpha = fmod(t, 1.0f);
+    float alpha = t - i0;
     
     x = lerp(pnts[i0], pnts[i1], alpha);
-    v = (pnts[i0] - pnts[i1]) / npnts;
+    v = (pnts[i1] - pnts[i0]) * (npnts - 1);
 }
 
 //--------------------------------------
 
-enum
+// Parameter value of each point, increasing from 0 to 1, along 
+// with a table giving the segment at the start of each of a set
+// of uniform buckets so that finding the segment for a given `t` 
+// takes at most a step or two from the table entry.
+struct curve_knots
 {
-    CTRL_MAX = 8,
+    int nknots;
+    float knots[CTRL_MAX];
+    int lookup[KNOT_LOOKUP_MAX + 1];
 };
 
+void curve_knots_build_lookup(curve_knots& knots)
+{
+    int segment = 0;
+    for (int b = 0; b <= KNOT_LOOKUP_MAX; b++)
+    {
+        float t = (float)b / KNOT_LOOKUP_MAX;
+        while (segment < knots.nknots - 2 && t >= knots.knots[segment + 1])
+        {
+            segment++;
+        }
+        knots.lookup[b] = segment;
+    }
+}
+
+// Returns false unless there are between 2 and `CTRL_MAX` points
+bool curve_knots_uniform(curve_knots& knots, int npnts)
+{
+    if (npnts < 2 || npnts > CTRL_MAX)
+    {
+        return false;
+    }
+    
+    knots.nknots = npnts;
+    for (int i = 0; i < npnts; i++)
+    {
+        knots.knots[i] = (float)i / (npnts - 1);
+    }
+    
+    curve_knots_build_lookup(knots);
+    return true;
+}
+
+// Knots spaced by the distance between points, so that 
+// the curve is traversed at a more even speed
+bool curve_knots_chordal(
+    curve_knots& knots, 
+    float pntsx[], 
+    float pntsy[], 
+    int npnts, 
+    float eps = 1e-5f)
+{
+    if (npnts < 2 || npnts > CTRL_MAX)
+    {
+        return false;
+    }
+    
+    knots.nknots = npnts;
+    knots.knots[0] = 0.0f;
+    for (int i = 1; i < npnts; i++)
+    {
+        knots.knots[i] = knots.knots[i - 1] + eps + sqrtf(
+            squaref(pntsx[i] - pntsx[i - 1]) + 
+            squaref(pntsy[i] - pntsy[i - 1]));
+    }
+    
+    for (int i = 1; i < npnts; i++)
+    {
+        knots.knots[i] /= knots.knots[npnts - 1];
+    }
+    
+    curve_knots_build_lookup(knots);
+    return true;
+}
+
+// Samples the curve at many `t` values at once. As with
+// `piecewise_interpolation`, `v` is the derivative with 
+// respect to `t`.
+void piecewise_interpolation_batch(
+    float x[],
+    float v[],
+    const float t[],
+    int count,
+    const float pnts[],
+    const curve_knots& knots,
+    float eps = 1e-8f)
+{
+    for (int i = 0; i < count; i++)
+    {
+        float ti = clamp(t[i], 0.0f, 1.0f);
+        int i0 = knots.lookup[(int)(ti * KNOT_LOOKUP_MAX)];
+        while (i0 < knots.nknots - 2 && ti >= knots.knots[i0 + 1])
+        {
+            i0++;
+        }
+        
+        float k0 = knots.knots[i0 + 0];
+        float k1 = knots.knots[i0 + 1];
+        float scale = 1.0f / max(k1 - k0, eps);
+        
+        x[i] = lerp(pnts[i0], pnts[i0 + 1], (ti - k0) * scale);
+        v[i] = (pnts[i0 + 1] - pnts[i0]) * scale;
+    }
+}
+
+//--------------------------------------
+
+// Caches the spring state at each subsample of the filtered
+// curve so that when a control point moves only the part of 
+// the curve from the first affected subsample onward needs to
+// be re-evaluated.
+struct spring_curve
+{
+    int dirty;                   // First subsample which needs re-evaluating
+    float halflife;
+    float frequency;
+    float x[SUBSAMPLE_MAX + 1];  // Spring position before each subsample
+    float v[SUBSAMPLE_MAX + 1];  // Spring velocity before each subsample
+    float goal[SUBSAMPLE_MAX];   // Curve position at each subsample
+    float goalv[SUBSAMPLE_MAX];  // Curve tangent at each subsample
+};
+
+void spring_curve_init(spring_curve& curve)
+{
+    curve.dirty = 0;
+    curve.halflife = 0.0f;
+    curve.frequency = 0.0f;
+}
+
+// Knots which depend on the point positions (such as chordal
+// knots) change when any point moves, in which case the whole
+// curve should be invalidated by passing a `pnt` of zero.
+void spring_curve_invalidate(
+    spring_curve& curve, 
+    int pnt, 
+    const curve_knots& knots, 
+    int subsamples)
+{
+    // The initial state depends on the first two points 
+    // and each subsample depends on the points either side
+    int first = pnt <= 1 ? 0 : (int)(knots.knots[pnt - 1] * (subsamples - 1));
+    curve.dirty = first < curve.dirty ? first : curve.dirty;
+}
+
+// Returns false unless `subsamples` is between 2 and `SUBSAMPLE_MAX`
+bool spring_curve_update(
+    spring_curve& curve,
+    float pnts[],
+    const curve_knots& knots,
+    int subsamples,
+    float halflife,
+    float frequency)
+{
+    if (subsamples < 2 || subsamples > SUBSAMPLE_MAX)
+    {
+        return false;
+    }
+    
+    if (curve.halflife != halflife || curve.frequency != frequency)
+    {
+        curve.halflife = halflife;
+        curve.frequency = frequency;
+        curve.dirty = 0;
+    }
+    
+    if (curve.dirty >= subsamples)
+    {
+        return true;
+    }
+    
+    // The curve takes one unit of time per point to traverse
+    float duration = (float)knots.nknots;
+    float dt = duration / subsamples;
+    
+    float ts[SUBSAMPLE_MAX];
+    for (int i = curve.dirty; i < subsamples; i++)
+    {
+        ts[i] = (float)i / (subsamples - 1);
+    }
+    
+    piecewise_interpolation_batch(
+        curve.goal + curve.dirty, 
+        curve.goalv + curve.dirty, 
+        ts + curve.dirty, 
+        subsamples - curve.dirty, 
+        pnts, 
+        knots);
+    
+    if (curve.dirty == 0)
+    {
+        curve.x[0] = curve.goal[0];
+        curve.v[0] = curve.goalv[0] / duration;
+    }
+    
+    for (int i = curve.dirty; i < subsamples; i++)
+    {
+        curve.x[i + 1] = curve.x[i];
+        curve.v[i + 1] = curve.v[i];
+        
+        spring_damper_exact(
+            curve.x[i + 1], curve.v[i + 1], 
+            curve.goal[i], curve.goalv[i] / duration, 
+            frequency, halflife, 
+            dt);
+    }
+    
+    curve.dirty = subsamples;
+    return true;
+}
+
+//--------------------------------------
+
 float ctrlx[CTRL_MAX];
 float ctrly[CTRL_MAX];
 
@@ -45,6 +259,14 @@ int main(void)
     float halflife = 0.5f;
     float frequency = 1.5f;
     int ctrl_selected = -1;
+    int subsamples = SUBSAMPLE_MAX;
+    
+    curve_knots knots;
+    curve_knots_uniform(knots, CTRL_MAX);
+    
+    spring_curve curvex, curvey;
+    spring_curve_init(curvex);
+    spring_curve_init(curvey);
 
     for (int i = 0; i < CTRL_MAX; i++)
     {
@@ -72,6 +294,9 @@ int main(void)
         {
             ctrlx[ctrl_selected] = GetMousePosition().x;
             ctrly[ctrl_selected] = GetMousePosition().y;
+            
+            spring_curve_invalidate(curvex, ctrl_selected, knots, subsamples);
+            spring_curve_invalidate(curvey, ctrl_selected, knots, subsamples);
         }
         
         // Interpolation
@@ -79,6 +304,9 @@ int main(void)
         GuiSliderBar((Rectangle){ 100, 20, 120, 20 }, "frequency", TextFormat("%5.3f", frequency), &frequency, 0.0f, 3.0f);
         GuiSliderBar((Rectangle){ 100, 45, 120, 20 }, "halflife", TextFormat("%5.3f", halflife), &halflife, 0.0f, 1.0f);
         
+        spring_curve_update(curvex, ctrlx, knots, subsamples, halflife, frequency);
+        spring_curve_update(curvey, ctrly, knots, subsamples, halflife, frequency);
+        
         BeginDrawing();
         
             ClearBackground(RAYWHITE);
@@ -95,28 +323,12 @@ int main(void)
                    (Vector2){ctrlx[i + 1], ctrly[i + 1]}, RED); 
             }
             
-            float sx = ctrlx[0];
-            float sy = ctrly[0];
-            float svx = (ctrlx[1] - ctrlx[0]) / CTRL_MAX;
-            float svy = (ctrly[1] - ctrly[0]) / CTRL_MAX;
+            DrawCircleV((Vector2){curvex.x[0], curvey.x[0]}, 2, BLUE);
             
-            DrawCircleV((Vector2){sx, sy}, 2, BLUE);
-            
-            int subsamples = 100;
             for (int i = 0; i < subsamples; i++)
             {
-               Vector2 start = {sx, sy};
-               
-               float goalx, goaly;
-               float goalvx, goalvy;
-               
-               piecewise_interpolation(goalx, goalvx, (float)i / (subsamples - 1), ctrlx, CTRL_MAX);
-               piecewise_interpolation(goaly, goalvy, (float)i / (subsamples - 1), ctrly, CTRL_MAX);
-               
-               spring_damper_exact(sx, svx, goalx, goalvx, halflife, frequency, (float)CTRL_MAX / subsamples);
-               spring_damper_exact(sy, svy, goaly, goalvy, halflife, frequency, (float)CTRL_MAX / subsamples);
-               
-               Vector2 stop = {sx, sy};
+               Vector2 start = {curvex.x[i + 0], curvey.x[i + 0]};
+               Vector2 stop = {curvex.x[i + 1], curvey.x[i + 1]};
                
                DrawLineV(start, stop, DARKBLUE); 
                
@@ -27,6 +27,165 @@ float resonant_frequency(float goal_frequency, float halflife)
 
 //--------------------------------------
 
+// The spring acts on its goal like a linear filter with transfer function
+// `s / (s - w^2 + i d w)`, so the gain and phase it applies to a goal 
+// oscillating at a given frequency can be computed directly without
+// any simulation. Results are stored with all the springs for one
+// input frequency next to each other so the inner loop runs over
+// springs and can be vectorized.
+void spring_frequency_response(
+    float gain[],
+    float phase[],
+    const float frequency[],
+    const float halflife[],
+    int count,
+    const float input_frequency[],
+    int input_count)
+{
+    for (int j = 0; j < input_count; j++)
+    {
+        float w = 2.0f * M_PI * input_frequency[j];
+        
+        for (int i = 0; i < count; i++)
+        {
+            float s = frequency_to_stiffness(frequency[i]);
+            float d = halflife_to_damping(halflife[i]);
+            float re = s - w*w;
+            float im = d * w;
+            
+            gain[j * count + i] = s / sqrtf(re*re + im*im);
+            phase[j * count + i] = -atan2f(im, re);
+        }
+    }
+}
+
+// Flags springs which amplify a goal oscillating at any of the given
+// input frequencies by more than `max_gain`. Returns the number flagged.
+int spring_resonance_check(
+    bool flagged[],
+    const float frequency[],
+    const float halflife[],
+    int count,
+    const float input_frequency[],
+    int input_count,
+    float max_gain = 1.0f)
+{
+    for (int i = 0; i < count; i++)
+    {
+        flagged[i] = false;
+    }
+    
+    for (int j = 0; j < input_count; j++)
+    {
+        float w = 2.0f * M_PI * input_frequency[j];
+        
+        for (int i = 0; i < count; i++)
+        {
+            float s = frequency_to_stiffness(frequency[i]);
+            float d = halflife_to_damping(halflife[i]);
+            float re = s - w*w;
+            float im = d * w;
+            
+            // Compare squared gains to avoid the square root
+            flagged[i] = flagged[i] || s*s > squaref(max_gain) * (re*re + im*im);
+        }
+    }
+    
+    int total = 0;
+    for (int i = 0; i < count; i++)
+    {
+        total += flagged[i];
+    }
+    
+    return total;
+}
+
+//--------------------------------------
+
+// Watches a pool of springs for ones whose energy relative to their goal
+// keeps growing, or which have become NaN or infinite. To keep the cost
+// low each spring is only checked once every `stride` frames, with the
+// checks staggered so that a different subset is checked each frame.
+
+enum
+{
+    ENERGY_MONITOR_MAX = 4096,
+};
+
+typedef void (*spring_energy_callback)(int index, float energy, void* user);
+
+struct spring_energy_monitor
+{
+    int count;
+    int stride;           // Frames between checks of the same spring
+    int growth_limit;     // Number of checks energy can grow for before flagging
+    int frame;
+    float energy[ENERGY_MONITOR_MAX]; // Energy at the last check
+    int growth[ENERGY_MONITOR_MAX];   // Number of checks energy has grown for
+};
+
+// Returns false if `count` is more than `ENERGY_MONITOR_MAX`
+// or `stride` is not positive
+bool spring_energy_monitor_init(
+    spring_energy_monitor& monitor,
+    int count,
+    int stride = 16,
+    int growth_limit = 8)
+{
+    if (count < 0 || count > ENERGY_MONITOR_MAX || stride <= 0)
+    {
+        return false;
+    }
+    
+    monitor.count = count;
+    monitor.stride = stride;
+    monitor.growth_limit = growth_limit;
+    monitor.frame = 0;
+    
+    for (int i = 0; i < count; i++)
+    {
+        monitor.energy[i] = 0.0f;
+        monitor.growth[i] = 0;
+    }
+    
+    return true;
+}
+
+void spring_energy_monitor_update(
+    spring_energy_monitor& monitor,
+    const float x[],
+    const float v[],
+    const float x_goal[],
+    const float frequency[],
+    spring_energy_callback callback,
+    void* user,
+    float eps = 1e-5f)
+{
+    int offset = monitor.frame % monitor.stride;
+    
+    for (int i = offset; i < monitor.count; i += monitor.stride)
+    {
+        float energy = spring_energy(x[i], v[i], frequency[i], x_goal[i]);
+        
+        bool grown = energy > monitor.energy[i] + eps;
+        monitor.growth[i] = grown ? monitor.growth[i] + 1 : 0;
+        monitor.energy[i] = energy;
+        
+        // Comparison is false for NaN so this also catches NaN
+        bool invalid = !(energy < INFINITY);
+        
+        if (invalid || monitor.growth[i] >= monitor.growth_limit)
+        {
+            monitor.growth[i] = 0;
+            callback(i, energy, user);
+        }
+    }
+    
+    monitor.frame++;
+}
+
+//--------------------------------------
+
 enum
 {
     HISTORY_MAX = 256
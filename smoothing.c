@@ -1,5 +1,449 @@
 #include "common.h"
 
+#include <stdio.h>
+
+//--------------------------------------
+
+enum
+{
+    SMOOTHING_DAMPER = 0,
+    SMOOTHING_SPRING = 1,
+    SMOOTHING_DOUBLE_SPRING = 2,
+};
+
+enum
+{
+    SMOOTHING_CHANNELS_MAX = 256,
+    SMOOTHING_CHUNK_FRAMES = 4096,
+};
+
+// Filter state for each channel. Intermediate 
+// state is only used by the double spring.
+struct smoothing_state
+{
+    float x[SMOOTHING_CHANNELS_MAX];
+    float v[SMOOTHING_CHANNELS_MAX];
+    float xi[SMOOTHING_CHANNELS_MAX];
+    float vi[SMOOTHING_CHANNELS_MAX];
+};
+
+void smoothing_state_init(
+    smoothing_state& state, 
+    const float data[], 
+    int channels)
+{
+    for (int c = 0; c < channels; c++)
+    {
+        state.x[c] = data[c];
+        state.v[c] = 0.0f;
+        state.xi[c] = data[c];
+        state.vi[c] = 0.0f;
+    }
+}
+
+// Filters `frames` frames of interleaved data in-place, carrying the
+// state across calls so long recordings can be processed in chunks.
+// Since `dt` is fixed the decay for each channel only needs computing
+// once per block, and the inner loop runs across channels so can be
+// vectorized by the compiler.
+void smoothing_filter_block(
+    smoothing_state& state,
+    float data[],
+    int frames,
+    int channels,
+    const float halflife[],
+    int filter,
+    float dt)
+{
+    float y[SMOOTHING_CHANNELS_MAX];
+    float eydt[SMOOTHING_CHANNELS_MAX];
+    
+    for (int c = 0; c < channels; c++)
+    {
+        float h = filter == SMOOTHING_DOUBLE_SPRING ? 0.5f * halflife[c] : halflife[c];
+        
+        y[c] = filter == SMOOTHING_DAMPER ? 
+            0.69314718056f / (h + 1e-5f) : 
+            halflife_to_damping(h) / 2.0f;
+        
+        eydt[c] = fast_negexp(y[c]*dt);
+    }
+    
+    for (int f = 0; f < frames; f++)
+    {
+        float* frame = data + f * channels;
+        
+        if (filter == SMOOTHING_DAMPER)
+        {
+            for (int c = 0; c < channels; c++)
+            {
+                state.x[c] = lerp(frame[c], state.x[c], eydt[c]);
+                frame[c] = state.x[c];
+            }
+        }
+        else if (filter == SMOOTHING_SPRING)
+        {
+            for (int c = 0; c < channels; c++)
+            {
+                float j0 = state.x[c] - frame[c];
+                float j1 = state.v[c] + j0*y[c];
+                
+                state.x[c] = eydt[c]*(j0 + j1*dt) + frame[c];
+                state.v[c] = eydt[c]*(state.v[c] - j1*y[c]*dt);
+                frame[c] = state.x[c];
+            }
+        }
+        else if (filter == SMOOTHING_DOUBLE_SPRING)
+        {
+            for (int c = 0; c < channels; c++)
+            {
+                float ji0 = state.xi[c] - frame[c];
+                float ji1 = state.vi[c] + ji0*y[c];
+                
+                state.xi[c] = eydt[c]*(ji0 + ji1*dt) + frame[c];
+                state.vi[c] = eydt[c]*(state.vi[c] - ji1*y[c]*dt);
+                
+                float j0 = state.x[c] - state.xi[c];
+                float j1 = state.v[c] + j0*y[c];
+                
+                state.x[c] = eydt[c]*(j0 + j1*dt) + state.xi[c];
+                state.v[c] = eydt[c]*(state.v[c] - j1*y[c]*dt);
+                frame[c] = state.x[c];
+            }
+        }
+    }
+}
+
+// Streams a raw file of interleaved float frames through the filter 
+// one chunk at a time, so the recording never needs to fit in memory.
+// Returns false if the input ends part way through a frame, after 
+// writing all the complete frames.
+bool smoothing_filter_file(
+    const char* input_filename,
+    const char* output_filename,
+    int channels,
+    const float halflife[],
+    int filter,
+    float dt)
+{
+    if (channels <= 0 || channels > SMOOTHING_CHANNELS_MAX)
+    {
+        return false;
+    }
+    
+    FILE* input = fopen(input_filename, "rb");
+    if (input == NULL)
+    {
+        return false;
+    }
+    
+    FILE* output = fopen(output_filename, "wb");
+    if (output == NULL)
+    {
+        fclose(input);
+        return false;
+    }
+    
+    float* chunk = (float*)malloc(sizeof(float) * SMOOTHING_CHUNK_FRAMES * SMOOTHING_CHANNELS_MAX);
+    if (chunk == NULL)
+    {
+        fclose(input);
+        fclose(output);
+        return false;
+    }
+    
+    smoothing_state state;
+    
+    int chunk_frames = SMOOTHING_CHUNK_FRAMES * SMOOTHING_CHANNELS_MAX / channels;
+    bool first = true;
+    bool success = true;
+    
+    size_t frame_size = sizeof(float) * channels;
+    
+    while (true)
+    {
+        // Read bytes rather than whole frames so that a 
+        // truncated final frame can be detected
+        size_t bytes = fread(chunk, 1, frame_size * chunk_frames, input);
+        int frames = (int)(bytes / frame_size);
+        
+        if (bytes % frame_size != 0)
+        {
+            success = false;
+        }
+        
+        if (frames == 0)
+        {
+            break;
+        }
+        
+        if (first)
+        {
+            smoothing_state_init(state, chunk, channels);
+            first = false;
+        }
+        
+        smoothing_filter_block(state, chunk, frames, channels, halflife, filter, dt);
+        
+        if ((int)fwrite(chunk, frame_size, frames, output) != frames)
+        {
+            success = false;
+            break;
+        }
+        
+        if (!success)
+        {
+            break;
+        }
+    }
+    
+    success = success && !ferror(input);
+    
+    free(chunk);
+    fclose(input);
+    fclose(output);
+    
+    return success;
+}
+
+//--------------------------------------
+
+// Runs a critical spring over `count` values of `in` writing to `out`,
+// stepping through memory with `stride` so that a negative stride
+// can be used to run the spring backward in time.
+void smoothing_spring_pass(
+    float out[],
+    const float in[],
+    int count,
+    int stride,
+    float x,
+    float v,
+    float halflife,
+    float dt)
+{
+    float y = halflife_to_damping(halflife) / 2.0f;
+    float eydt = fast_negexp(y*dt);
+    
+    for (int i = 0; i < count; i++)
+    {
+        float g = in[i * stride];
+        float j0 = x - g;
+        float j1 = v + j0*y;
+        
+        x = eydt*(j0 + j1*dt) + g;
+        v = eydt*(v - j1*y*dt);
+        out[i * stride] = x;
+    }
+}
+
+// Initial velocity for a pass starting at `in[0]`
+float smoothing_initial_velocity(const float in[], int count, int stride, float dt)
+{
+    return count > 1 ? (in[stride] - in[0]) / dt : 0.0f;
+}
+
+// Runs the spring forward and then backward over the data so that the
+// lag of the two passes cancels out. Each pass starts from the input 
+// value and slope at its end so there is no lag at either end either.
+void smoothing_zero_lag(
+    float out[],
+    const float in[],
+    int count,
+    float halflife,
+    float dt)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+    
+    smoothing_spring_pass(out, in, count, 1, 
+        in[0], smoothing_initial_velocity(in, count, 1, dt), 
+        halflife, dt);
+    
+    smoothing_spring_pass(out + count - 1, out + count - 1, count, -1, 
+        in[count - 1], smoothing_initial_velocity(in + count - 1, count, -1, dt), 
+        halflife, dt);
+}
+
+// Number of frames needed for the effect of the initial state 
+// of a pass to decay below float precision
+int smoothing_zero_lag_overlap(float halflife, float dt)
+{
+    return (int)ceilf((15.0f * halflife) / dt) + 1;
+}
+
+// Computes `out[start..stop]` of the zero lag filter, warming each pass 
+// up over `overlap` extra frames either side. Chunks don't depend on
+// each other so can be run in parallel. `scratch` needs room for 
+// `stop - start + 2 * overlap` values.
+void smoothing_zero_lag_chunk(
+    float out[],
+    float scratch[],
+    const float in[],
+    int count,
+    int start,
+    int stop,
+    int overlap,
+    float halflife,
+    float dt)
+{
+    int lo = start - overlap > 0 ? start - overlap : 0;
+    int hi = stop + overlap < count ? stop + overlap : count;
+    
+    smoothing_spring_pass(scratch, in + lo, hi - lo, 1, 
+        in[lo], smoothing_initial_velocity(in + lo, hi - lo, 1, dt), 
+        halflife, dt);
+    
+    smoothing_spring_pass(scratch + hi - lo - 1, scratch + hi - lo - 1, hi - lo, -1, 
+        in[hi - 1], smoothing_initial_velocity(in + hi - 1, hi - lo, -1, dt), 
+        halflife, dt);
+    
+    memcpy(out + start, scratch + start - lo, sizeof(float) * (stop - start));
+}
+
+// Chunks are spread across cores when built with OpenMP. Returns 
+// false if `chunk_size` is invalid or the scratch memory could not
+// be allocated.
+bool smoothing_zero_lag_parallel(
+    float out[],
+    const float in[],
+    int count,
+    int chunk_size,
+    float halflife,
+    float dt)
+{
+    if (chunk_size <= 0 || count < 0)
+    {
+        return false;
+    }
+    
+    if (count == 0)
+    {
+        return true;
+    }
+    
+    int overlap = smoothing_zero_lag_overlap(halflife, dt);
+    int chunks = (count + chunk_size - 1) / chunk_size;
+    int scratch_size = chunk_size + 2 * overlap;
+    
+    float* scratch = (float*)malloc(sizeof(float) * scratch_size * chunks);
+    if (scratch == NULL)
+    {
+        return false;
+    }
+    
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+    for (int c = 0; c < chunks; c++)
+    {
+        int start = c * chunk_size;
+        int stop = start + chunk_size < count ? start + chunk_size : count;
+        
+        smoothing_zero_lag_chunk(
+            out, scratch + c * scratch_size, in, count,
+            start, stop, overlap, halflife, dt);
+    }
+    
+    free(scratch);
+    return true;
+}
+
+//--------------------------------------
+
+// A Hampel gate over a short causal window for rejecting single frame 
+// spikes before they reach the spring. Any value further from the 
+// median of the window than `threshold` times the (scaled) median
+// absolute deviation gets replaced by the median. Like the block 
+// filter above the inner loops run across channels.
+
+enum
+{
+    HAMPEL_WINDOW = 5,
+};
+
+struct hampel_state
+{
+    int index;
+    float window[HAMPEL_WINDOW][SMOOTHING_CHANNELS_MAX];
+};
+
+void hampel_state_init(
+    hampel_state& state, 
+    const float data[], 
+    int channels)
+{
+    state.index = 0;
+    for (int i = 0; i < HAMPEL_WINDOW; i++)
+    {
+        for (int c = 0; c < channels; c++)
+        {
+            state.window[i][c] = data[c];
+        }
+    }
+}
+
+// Median of five values using a sorting network made of 
+// min and max so that there is no branching
+float median5(float a, float b, float c, float d, float e)
+{
+    float t;
+    t = min(a, b); b = max(a, b); a = t;
+    t = min(d, e); e = max(d, e); d = t;
+    t = min(c, e); e = max(c, e); c = t;
+    t = min(c, d); d = max(c, d); c = t;
+    t = min(a, d); d = max(a, d); a = t;
+    t = min(a, c); c = max(a, c); a = t;
+    t = min(b, e); e = max(b, e); b = t;
+    t = min(b, d); d = max(b, d); b = t;
+    t = min(b, c); c = max(b, c); b = t;
+    return c;
+}
+
+void hampel_filter_frame(
+    hampel_state& state,
+    float frame[],
+    int channels,
+    float threshold = 3.0f,
+    float eps = 1e-5f)
+{
+    float (*w)[SMOOTHING_CHANNELS_MAX] = state.window;
+    
+    for (int c = 0; c < channels; c++)
+    {
+        w[state.index][c] = frame[c];
+    }
+    
+    state.index = (state.index + 1) % HAMPEL_WINDOW;
+    
+    for (int c = 0; c < channels; c++)
+    {
+        float m = median5(w[0][c], w[1][c], w[2][c], w[3][c], w[4][c]);
+        
+        float mad = 1.4826f * median5(
+            fabs(w[0][c] - m), fabs(w[1][c] - m), fabs(w[2][c] - m), 
+            fabs(w[3][c] - m), fabs(w[4][c] - m));
+        
+        frame[c] = fabs(frame[c] - m) > threshold * mad + eps ? m : frame[c];
+    }
+}
+
+void hampel_filter_block(
+    hampel_state& state,
+    float data[],
+    int frames,
+    int channels,
+    float threshold = 3.0f)
+{
+    for (int f = 0; f < frames; f++)
+    {
+        hampel_filter_frame(state, data + f * channels, channels, threshold);
+    }
+}
+
+//--------------------------------------
+
 enum
 {
     HISTORY_MAX = 256
@@ -33,6 +477,10 @@ int main(void)
     float noise = 0.0f;
     float jitter = 0.0f;
     
+    bool reject_outliers = false;
+    hampel_state hampel;
+    hampel_state_init(hampel, &g, 1);
+    
     SetTargetFPS(1.0f / dt);
 
     for (int i = 0; i < HISTORY_MAX; i++)
@@ -78,6 +526,7 @@ int main(void)
         GuiSliderBar((Rectangle){ 100, 20, 120, 20 }, "halflife", TextFormat("%5.3f", halflife), &halflife, 0.0f, 1.0f);
         GuiSliderBar((Rectangle){ 100, 45, 120, 20 }, "dt", TextFormat("%5.3f", dt), &dt, 1.0 / 60.0f, 0.1f);
         GuiSliderBar((Rectangle){ 100, 70, 120, 20 }, "noise", TextFormat("%5.3f", noise), &noise, 0.0f, 20.0f);
+        GuiCheckBox((Rectangle){ 100, 95, 20, 20 }, "reject outliers", &reject_outliers);
         
         // Update Spring
         
@@ -85,7 +534,10 @@ int main(void)
         
         t += dt;
         
-        simple_spring_damper_exact(x, v, g, halflife, dt);
+        float g_filtered = g;
+        hampel_filter_frame(hampel, &g_filtered, 1);
+        
+        simple_spring_damper_exact(x, v, reject_outliers ? g_filtered : g, halflife, dt);
         
         x_prev[0] = x;
         v_prev[0] = v;      
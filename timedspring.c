@@ -26,6 +26,90 @@ void timed_spring_damper_exact(
 
 //--------------------------------------
 
+enum
+{
+    TIMED_SPRING_POOL_MAX = 4096
+};
+
+// Pool of timed springs stored as separate arrays. Rather than 
+// counting down a timer for each spring we store the absolute
+// time at which each should arrive and compute the time remaining
+// from the global clock during the update. The clock and arrival 
+// times are kept in double precision so that the time remaining 
+// stays accurate after many hours of running.
+struct timed_spring_pool
+{
+    int count;
+    float x[TIMED_SPRING_POOL_MAX];
+    float v[TIMED_SPRING_POOL_MAX];
+    float xi[TIMED_SPRING_POOL_MAX];
+    float x_goal[TIMED_SPRING_POOL_MAX];
+    double t_goal[TIMED_SPRING_POOL_MAX];  // Absolute time of arrival
+    float halflife[TIMED_SPRING_POOL_MAX];
+};
+
+void timed_spring_pool_init(timed_spring_pool& pool)
+{
+    pool.count = 0;
+}
+
+int timed_spring_pool_add(
+    timed_spring_pool& pool,
+    float x,
+    float halflife,
+    double time)
+{
+    if (pool.count >= TIMED_SPRING_POOL_MAX)
+    {
+        return -1;
+    }
+    
+    int i = pool.count++;
+    pool.x[i] = x;
+    pool.v[i] = 0.0f;
+    pool.xi[i] = x;
+    pool.x_goal[i] = x;
+    pool.t_goal[i] = time;
+    pool.halflife[i] = halflife;
+    return i;
+}
+
+void timed_spring_pool_set_goal(
+    timed_spring_pool& pool,
+    int i,
+    float x_goal,
+    double t_goal)
+{
+    pool.x_goal[i] = x_goal;
+    pool.t_goal[i] = t_goal;
+}
+
+// Here `time` is the global clock after it has been advanced by `dt`
+void timed_spring_pool_update(
+    timed_spring_pool& pool,
+    double time,
+    float dt)
+{
+    for (int i = 0; i < pool.count; i++)
+    {
+        float t_goal = pool.t_goal[i] > time ? (float)(pool.t_goal[i] - time) : 0.0f;
+        float min_time = max(t_goal, dt);
+        
+        float v_goal = (pool.x_goal[i] - pool.xi[i]) / min_time;
+        
+        float t_goal_future = halflife_to_lag(pool.halflife[i]);
+        float x_goal_future = t_goal_future < t_goal ?
+            pool.xi[i] + v_goal * t_goal_future : pool.x_goal[i];
+        
+        simple_spring_damper_exact(
+            pool.x[i], pool.v[i], x_goal_future, pool.halflife[i], dt);
+        
+        pool.xi[i] += v_goal * dt;
+    }
+}
+
+//--------------------------------------
+
 enum
 {
     HISTORY_MAX = 256
@@ -197,6 +197,240 @@ void tracking_spring_update_no_velocity_acceleration_exact(
 
 //--------------------------------------
 
+// Tracking spring with the conversion from gains to 
+// spring parameters done once up-front
+struct tracking_spring
+{
+    spring_damper_params params;        // Used with velocity and acceleration goals
+    spring_damper_params params_x_only; // Used with position goal only
+    float v_goal_scale;
+    float a_goal_scale;
+};
+
+void tracking_spring_compile(
+    tracking_spring& ts,
+    float x_gain,
+    float v_gain,
+    float a_gain,
+    float gain_dt)
+{
+    float t0 = (1.0f - v_gain) * (1.0f - x_gain);
+    float t1 = a_gain * (1.0f - v_gain) * (1.0f - x_gain);
+    float t2 = (v_gain * (1.0f - x_gain)) / gain_dt;
+    float t3 = x_gain / (gain_dt*gain_dt);
+    
+    float stiffness = t3;
+    float damping = (1.0f - t0) / gain_dt;
+    float damping_x_only = x_gain / gain_dt;
+    
+    spring_damper_params_stiffness_damping(ts.params, stiffness, damping);
+    spring_damper_params_stiffness_damping(ts.params_x_only, stiffness, damping_x_only);
+    
+    ts.v_goal_scale = t2 / damping;
+    ts.a_goal_scale = t1 / damping;
+}
+
+void tracking_spring_update_compiled(
+    float& x,
+    float& v,
+    float x_goal,
+    float v_goal,
+    float a_goal,
+    const tracking_spring& ts,
+    float dt)
+{
+    spring_damper_exact_params(
+      x, 
+      v, 
+      x_goal,
+      ts.v_goal_scale*v_goal + ts.a_goal_scale*a_goal,
+      ts.params,
+      dt);
+}
+
+void tracking_spring_update_no_acceleration_compiled(
+    float& x,
+    float& v,
+    float x_goal,
+    float v_goal,
+    const tracking_spring& ts,
+    float dt)
+{
+    spring_damper_exact_params(
+      x, 
+      v, 
+      x_goal,
+      ts.v_goal_scale*v_goal,
+      ts.params,
+      dt);
+}
+
+void tracking_spring_update_no_velocity_acceleration_compiled(
+    float& x,
+    float& v,
+    float x_goal,
+    const tracking_spring& ts,
+    float dt)
+{
+    spring_damper_exact_params(
+      x, 
+      v, 
+      x_goal,
+      0.0f,
+      ts.params_x_only,
+      dt);
+}
+
+//--------------------------------------
+
+// Updates many tracking springs sharing the same gains and dt. 
+// Rather than a separate pass for each of the three cases above 
+// each spring has a mask (0.0 or 1.0) saying if its velocity and
+// acceleration goals are valid, and the loop body is kept free 
+// of branches so the compiler can vectorize it.
+void tracking_spring_update_compiled_batch(
+    float x[],
+    float v[],
+    const float x_goal[],
+    const float v_goal[],
+    const float a_goal[],
+    const float v_mask[],
+    const float a_mask[],
+    const tracking_spring& ts,
+    int count,
+    float dt)
+{
+    float txx, txv, tvx, tvv;
+    float uxx, uxv, uvx, uvv;
+    spring_damper_transition(txx, txv, tvx, tvv, ts.params, dt);
+    spring_damper_transition(uxx, uxv, uvx, uvv, ts.params_x_only, dt);
+    
+    for (int i = 0; i < count; i++)
+    {
+        float m = v_mask[i];
+        float q = m * (ts.v_goal_scale*v_goal[i] + a_mask[i] * ts.a_goal_scale*a_goal[i]);
+        float c = x_goal[i] + ts.params.cq * q;
+        
+        float xc = x[i] - c;
+        float vc = v[i];
+        
+        x[i] = lerp(uxx, txx, m)*xc + lerp(uxv, txv, m)*vc + c;
+        v[i] = lerp(uvx, tvx, m)*xc + lerp(uvv, tvv, m)*vc;
+    }
+}
+
+//--------------------------------------
+
+// When target samples arrive at a lower rate than we update the 
+// spring we can interpolate the goal between the two most recent 
+// samples, either linearly or with a cubic Hermite curve, and 
+// integrate the spring exactly against that moving goal. This 
+// costs one sample of latency.
+
+void tracking_goal_push(float goal_samples[3], float sample)
+{
+    goal_samples[2] = goal_samples[1];
+    goal_samples[1] = goal_samples[0];
+    goal_samples[0] = sample;
+}
+
+// Computes the polynomial coefficients of the interpolated 
+// goal in terms of the time since `t` into the current segment
+void tracking_goal_polynomial(
+    float x_goal[4],
+    const float goal_samples[3],
+    bool cubic,
+    float t,
+    float sample_dt)
+{
+    float p0 = goal_samples[1];
+    float p1 = goal_samples[0];
+    float v1 = (p1 - p0) / sample_dt;
+    float v0 = cubic ? (p1 - goal_samples[2]) / (2.0f * sample_dt) : v1;
+    
+    float c0 = p0;
+    float c1 = v0 * sample_dt;
+    float c2 = 3.0f*(p1 - p0) - (2.0f*v0 + v1) * sample_dt;
+    float c3 = 2.0f*(p0 - p1) + (v0 + v1) * sample_dt;
+    
+    float u = t / sample_dt;
+    
+    x_goal[0] = c0 + u*(c1 + u*(c2 + u*c3));
+    x_goal[1] = (c1 + u*(2.0f*c2 + u*3.0f*c3)) / sample_dt;
+    x_goal[2] = (c2 + u*3.0f*c3) / (sample_dt*sample_dt);
+    x_goal[3] = c3 / (sample_dt*sample_dt*sample_dt);
+}
+
+// The frame is split at each segment boundary so that samples 
+// which arrived during the frame, given oldest first in 
+// `new_samples`, are taken as soon as they are reached. The goal 
+// is only held at the newest sample if the next one is late.
+void tracking_spring_update_multirate(
+    float& x,
+    float& v,
+    float& goal_t,               // Time into the current goal segment
+    float goal_samples[3],       // Most recent target samples, newest first
+    const float new_samples[],   // Samples arriving during this frame, oldest first
+    int new_count,
+    bool cubic,
+    const tracking_spring& ts,
+    float sample_dt,
+    float dt)
+{
+    int next = 0;
+    
+    while (dt > 0.0f)
+    {
+        if (goal_t >= sample_dt && next < new_count)
+        {
+            tracking_goal_push(goal_samples, new_samples[next]);
+            goal_t -= sample_dt;
+            next++;
+        }
+        
+        if (goal_t < sample_dt)
+        {
+            float x_goal[4], v_goal[4];
+            tracking_goal_polynomial(x_goal, goal_samples, cubic, goal_t, sample_dt);
+            
+            // Velocity goal of the spring is a mix of the goal's 
+            // velocity and acceleration, so is also a polynomial
+            v_goal[0] = ts.v_goal_scale*x_goal[1] + ts.a_goal_scale*2.0f*x_goal[2];
+            v_goal[1] = ts.v_goal_scale*2.0f*x_goal[2] + ts.a_goal_scale*6.0f*x_goal[3];
+            v_goal[2] = ts.v_goal_scale*3.0f*x_goal[3];
+            v_goal[3] = 0.0f;
+            
+            float segment_dt = min(sample_dt - goal_t, dt);
+            
+            spring_damper_exact_params_polynomial_goal(
+                x, v, x_goal, v_goal, ts.params, segment_dt);
+            
+            goal_t = segment_dt < dt ? sample_dt : goal_t + segment_dt;
+            dt -= segment_dt;
+        }
+        else
+        {
+            // Next sample is late so hold the goal at the newest sample
+            tracking_spring_update_no_acceleration_compiled(
+                x, v, goal_samples[0], 0.0f, ts, dt);
+            
+            goal_t += dt;
+            dt = 0.0f;
+        }
+    }
+    
+    // Take samples arriving right at the end of the frame, or 
+    // any extra ones if we have fallen behind the sample clock
+    while (next < new_count)
+    {
+        tracking_goal_push(goal_samples, new_samples[next]);
+        goal_t = max(goal_t - sample_dt, 0.0f);
+        next++;
+    }
+}
+
+//--------------------------------------
+
 float tracking_target_acceleration(
     float x_next,
     float x_curr,
@@ -218,7 +452,8 @@ float tracking_target_velocity(
 
 enum
 {
-    HISTORY_MAX = 256
+    HISTORY_MAX = 256,
+    MULTIRATE_SAMPLES_MAX = 8,
 };
 
 float x_prev[HISTORY_MAX];
@@ -264,6 +499,16 @@ int main(void)
     bool improved = true;
     bool exact = true;
     
+    tracking_spring ts;
+    tracking_spring_compile(ts, x_gain, v_gain, a_gain, 1.0f / 60.0f);
+    
+    bool multirate = false;
+    bool multirate_cubic = true;
+    float sample_dt = 1.0f / 30.0f;
+    float sample_time = t;
+    float goal_t = 0.0f;
+    float goal_samples[3] = { x, x, x };
+    
     SetTargetFPS(1.0f / dt);
 
     for (int i = 0; i < HISTORY_MAX; i++)
@@ -325,7 +570,42 @@ int main(void)
           dt);
         */
         
-        if (clamping || time_since_switch > 1)
+        if (multirate)
+        {
+            // Gather the target samples which arrived during this frame
+            
+            float new_samples[MULTIRATE_SAMPLES_MAX];
+            int new_count = 0;
+            
+            while (new_count < MULTIRATE_SAMPLES_MAX && sample_time + sample_dt <= t)
+            {
+                float sample_v = 0.0f;
+                sample_time += sample_dt;
+                
+                if (tracking_toggle)
+                {
+                    tracking_function1(new_samples[new_count], sample_v, sample_time);
+                }
+                else
+                {
+                    tracking_function2(new_samples[new_count], sample_v, sample_time);
+                }
+                
+                new_count++;
+            }
+            
+            tracking_spring_update_multirate(
+                x, v,
+                goal_t,
+                goal_samples,
+                new_samples,
+                new_count,
+                multirate_cubic,
+                ts,
+                sample_dt,
+                dt);
+        }
+        else if (clamping || time_since_switch > 1)
         {
             float x_goal = g;
             float v_goal = tracking_target_velocity(g, g_prev[1], dt);
@@ -339,12 +619,11 @@ int main(void)
             
             if (exact)
             {
-                tracking_spring_update_exact(
+                tracking_spring_update_compiled(
                     x, v,
                     x_goal, v_goal, a_goal,
-                    x_gain, v_gain, a_gain,
-                    dt,
-                    1.0f / 60.0f);
+                    ts,
+                    dt);
             }
             else if (improved)
             {
@@ -370,12 +649,11 @@ int main(void)
             
             if (exact)
             {
-                tracking_spring_update_no_acceleration_exact(
+                tracking_spring_update_no_acceleration_compiled(
                     x, v,
                     x_goal, v_goal,
-                    x_gain, v_gain,
-                    dt,
-                    1.0f / 60.0f);
+                    ts,
+                    dt);
             }
             else if (improved)
             {
@@ -400,12 +678,11 @@ int main(void)
             
             if (exact)
             {
-                tracking_spring_update_no_velocity_acceleration_exact(
+                tracking_spring_update_no_velocity_acceleration_compiled(
                     x, v,
                     x_goal, 
-                    x_gain,
-                    dt,
-                    1.0f / 60.0f);
+                    ts,
+                    dt);
             }
             else if (improved)
             {
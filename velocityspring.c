@@ -23,6 +23,55 @@ void velocity_spring_damper_exact(
     xi = fabs(x_goal - xi) > dt * v_goal ? xi + x_diff * dt : x_goal; 
 }
 
+// Batched version for vectors of `D` dimensions stored interleaved. The
+// intermediate goal approaches the real goal along the direction to it 
+// rather than per axis, and the distance moved is clamped with `min` 
+// rather than a branch. All springs share the same halflife so the lag 
+// and decay are only computed once.
+template<int D>
+void velocity_spring_damper_exact_batch(
+    float x[],
+    float v[],
+    float xi[],
+    const float x_goal[],
+    const float v_goal[],
+    int count,
+    float halflife,
+    float dt,
+    float eps = 1e-5f)
+{
+    float t_goal_future = halflife_to_lag(halflife);
+    float y = halflife_to_damping(halflife) / 2.0f;
+    float eydt = fast_negexp(y*dt);
+    
+    for (int i = 0; i < count; i++)
+    {
+        float dist2 = 0.0f;
+        for (int d = 0; d < D; d++)
+        {
+            dist2 += squaref(x_goal[i*D+d] - xi[i*D+d]);
+        }
+        
+        float dist = sqrtf(dist2);
+        float scale_future = min(dist, t_goal_future * v_goal[i]) / max(dist, eps);
+        float scale_dt = min(dist, dt * v_goal[i]) / max(dist, eps);
+        
+        for (int d = 0; d < D; d++)
+        {
+            float x_diff = x_goal[i*D+d] - xi[i*D+d];
+            float x_goal_future = xi[i*D+d] + scale_future * x_diff;
+            
+            float j0 = x[i*D+d] - x_goal_future;
+            float j1 = v[i*D+d] + j0*y;
+            
+            x[i*D+d] = eydt*(j0 + j1*dt) + x_goal_future;
+            v[i*D+d] = eydt*(v[i*D+d] - j1*y*dt);
+            
+            xi[i*D+d] += scale_dt * x_diff;
+        }
+    }
+}
+
 //--------------------------------------
 
 enum